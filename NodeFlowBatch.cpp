@@ -0,0 +1,276 @@
+// NodeFlowBatch.cpp
+//
+// Batched multi-instance engine: one topology, N instances evaluated per pass
+// with instance-contiguous port arrays. Kernel semantics match FlowEngine
+// (TYPERULES.md): edges cast to the destination dtype, Add computes in its
+// output dtype, Counter counts rising edges, Timer pulses 1 then 0. Changes
+// are detected per output port (within its deadband, per instance), and only
+// that port's consumers are scheduled.
+#include "NodeFlowBatch.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+
+namespace NodeFlow {
+
+void BatchFlowEngine::loadFromJson(const nlohmann::json& json, size_t instances) {
+    if (instances == 0) throw std::runtime_error("Batch engine needs at least one instance");
+    topo.loadFromJson(json);
+    for (const auto &pd : topo.portDescs) {
+        if (topo.portSlot[pd.handle].lane == DType::String) {
+            throw std::runtime_error("Batch mode supports numeric ports only: " + pd.nodeId + ":" + pd.portId);
+        }
+    }
+    count = instances;
+    laneInt.assign(topo.laneInt.size() * count, 0);
+    laneFloat.assign(topo.laneFloat.size() * count, 0.0f);
+    laneDouble.assign(topo.laneDouble.size() * count, 0.0);
+
+    // One state row per stateful node, in the array matching its kernel
+    const size_t n = topo.nodes.size();
+    nodeRow.assign(n, -1);
+    int params = 0, timers = 0, counters = 0;
+    for (size_t ni = 0; ni < n; ++ni) {
+        switch (topo.plan.kernel[ni]) {
+            case FlowEngine::KernelValue:
+            case FlowEngine::KernelDeviceTrigger: nodeRow[ni] = params++; break;
+            case FlowEngine::KernelTimer:         nodeRow[ni] = timers++; break;
+            case FlowEngine::KernelCounter:       nodeRow[ni] = counters++; break;
+            default: break;
+        }
+    }
+    paramValue.assign(static_cast<size_t>(params) * count, 0.0);
+    paramSet.assign(static_cast<size_t>(params) * count, 0);
+    timerAccumMs.assign(static_cast<size_t>(timers) * count, 0.0);
+    counterValue.assign(static_cast<size_t>(counters) * count, 0.0);
+    counterLast.assign(static_cast<size_t>(counters) * count, 0);
+    for (size_t ni = 0; ni < n; ++ni) {
+        const unsigned char k = topo.plan.kernel[ni];
+        if (k != FlowEngine::KernelValue && k != FlowEngine::KernelDeviceTrigger) continue;
+        // Every instance starts from the JSON "value"; Value nodes without one write 0
+        const bool known = topo.nodeParamSet[ni] || k == FlowEngine::KernelValue;
+        const size_t base = static_cast<size_t>(nodeRow[ni]) * count;
+        std::fill(paramValue.begin() + base, paramValue.begin() + base + count, topo.nodeParam[ni]);
+        std::fill(paramSet.begin() + base, paramSet.begin() + base + count, known ? 1 : 0);
+    }
+
+    dirty.assign(n, 0);
+    scratchInt.assign(count, 0);
+    scratchFloat.assign(count, 0.0f);
+    scratchDouble.assign(count, 0.0);
+    coldStart = true;
+}
+
+template <typename T>
+T* BatchFlowEngine::lanePtr(PortHandle h) {
+    return const_cast<T*>(static_cast<const BatchFlowEngine*>(this)->lanePtr<T>(h));
+}
+
+template <typename T>
+const T* BatchFlowEngine::lanePtr(PortHandle h) const {
+    const size_t base = static_cast<size_t>(topo.portSlot[h].slot) * count;
+    if constexpr (std::is_same<T, int>::value) return laneInt.data() + base;
+    else if constexpr (std::is_same<T, float>::value) return laneFloat.data() + base;
+    else return laneDouble.data() + base;
+}
+
+template <typename Load, typename Acc>
+void BatchFlowEngine::accumulatePort(PortHandle h, Acc* acc) const {
+    auto add = [&](const auto* src) {
+        for (size_t i = 0; i < count; ++i) acc[i] += static_cast<Acc>(static_cast<Load>(src[i]));
+    };
+    switch (topo.portSlot[h].lane) {
+        case DType::Int:    add(lanePtr<int>(h)); break;
+        case DType::Float:  add(lanePtr<float>(h)); break;
+        case DType::Double: add(lanePtr<double>(h)); break;
+        case DType::String: break;
+    }
+}
+
+// Instances with known[i] == 0 keep their current value. Like
+// FlowEngine::storeOutput, an instance whose new value stays within `band` of
+// its last propagated value keeps that value and does not count as a change.
+template <typename S>
+bool BatchFlowEngine::storePort(PortHandle h, const S* src, const unsigned char* known, double band) {
+    bool changed = false;
+    auto put = [&](auto* dst) {
+        using D = typename std::remove_pointer<decltype(dst)>::type;
+        for (size_t i = 0; i < count; ++i) {
+            if (known && !known[i]) continue;
+            const D v = static_cast<D>(src[i]);
+            const bool moved = band > 0.0 ? !(std::abs(static_cast<double>(v) - static_cast<double>(dst[i])) <= band) : dst[i] != v;
+            changed |= moved;
+            if (moved) dst[i] = v;
+        }
+    };
+    switch (topo.portSlot[h].lane) {
+        case DType::Int:    put(lanePtr<int>(h)); break;
+        case DType::Float:  put(lanePtr<float>(h)); break;
+        case DType::Double: put(lanePtr<double>(h)); break;
+        case DType::String: break;
+    }
+    return changed;
+}
+
+namespace {
+
+template <typename S, typename D>
+inline void copyCast(const S* src, D* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = static_cast<D>(src[i]);
+}
+
+} // namespace
+
+void BatchFlowEngine::propagateOutput(PortHandle hOut) {
+    const FlowEngine::ExecPlan &plan = topo.plan;
+    const size_t s = static_cast<size_t>(topo.portSlot[hOut].slot) * count;
+    for (int e = plan.outToIn.begin(hOut); e < plan.outToIn.end(hOut); ++e) {
+        const FlowEngine::EdgeTarget &t = plan.outToIn.items[e];
+        const size_t d = static_cast<size_t>(t.slot) * count;
+        switch (t.cast) {
+            case FlowEngine::IntToInt:       copyCast(&laneInt[s], &laneInt[d], count); break;
+            case FlowEngine::IntToFloat:     copyCast(&laneInt[s], &laneFloat[d], count); break;
+            case FlowEngine::IntToDouble:    copyCast(&laneInt[s], &laneDouble[d], count); break;
+            case FlowEngine::FloatToInt:     copyCast(&laneFloat[s], &laneInt[d], count); break;
+            case FlowEngine::FloatToFloat:   copyCast(&laneFloat[s], &laneFloat[d], count); break;
+            case FlowEngine::FloatToDouble:  copyCast(&laneFloat[s], &laneDouble[d], count); break;
+            case FlowEngine::DoubleToInt:    copyCast(&laneDouble[s], &laneInt[d], count); break;
+            case FlowEngine::DoubleToFloat:  copyCast(&laneDouble[s], &laneFloat[d], count); break;
+            case FlowEngine::DoubleToDouble: copyCast(&laneDouble[s], &laneDouble[d], count); break;
+            default: break;
+        }
+    }
+}
+
+// Schedule every node with an input wired to output hOut
+void BatchFlowEngine::markConsumers(PortHandle hOut) {
+    const FlowEngine::ExecPlan &plan = topo.plan;
+    for (int e = plan.outToIn.begin(hOut); e < plan.outToIn.end(hOut); ++e) dirty[plan.portNode[plan.outToIn.items[e].input]] = 1;
+}
+
+// Evaluate node ni for every instance and propagate its outputs. Only the
+// consumers of outputs that changed for at least one instance are scheduled.
+void BatchFlowEngine::evalNode(int ni) {
+    const FlowEngine::NodePorts &np = topo.plan.nodePorts[ni];
+    const PortHandle inEnd = np.firstInput + np.numInputs;
+    const PortHandle outEnd = np.firstOutput + np.numOutputs;
+    // Store one count-sized source into every output, scheduling per output
+    auto storeAll = [&](const auto* src, const unsigned char* known = nullptr) {
+        for (PortHandle h = np.firstOutput; h < outEnd; ++h) {
+            if (!storePort(h, src, known, topo.portDeadband[h])) continue;
+            propagateOutput(h);
+            markConsumers(h);
+        }
+    };
+    switch (topo.plan.kernel[ni]) {
+        case FlowEngine::KernelValue:
+        case FlowEngine::KernelDeviceTrigger: {
+            // Instances without a known value keep their current outputs
+            const size_t base = static_cast<size_t>(nodeRow[ni]) * count;
+            storeAll(&paramValue[base], &paramSet[base]);
+            break;
+        }
+        // Add: sum with compute dtype matching output dtype (cast inputs)
+        case FlowEngine::KernelAddInt:
+            std::fill(scratchInt.begin(), scratchInt.end(), 0LL);
+            for (PortHandle h = np.firstInput; h < inEnd; ++h) accumulatePort<int>(h, scratchInt.data());
+            for (size_t i = 0; i < count; ++i) scratchInt[i] = static_cast<int>(scratchInt[i]);
+            storeAll(scratchInt.data());
+            break;
+        case FlowEngine::KernelAddFloat:
+            std::fill(scratchFloat.begin(), scratchFloat.end(), 0.0f);
+            for (PortHandle h = np.firstInput; h < inEnd; ++h) accumulatePort<float>(h, scratchFloat.data());
+            storeAll(scratchFloat.data());
+            break;
+        case FlowEngine::KernelAddDouble:
+            std::fill(scratchDouble.begin(), scratchDouble.end(), 0.0);
+            for (PortHandle h = np.firstInput; h < inEnd; ++h) accumulatePort<double>(h, scratchDouble.data());
+            storeAll(scratchDouble.data());
+            break;
+        case FlowEngine::KernelCounter: {
+            // Rising-edge counter per instance: increments when input goes 0->1
+            const size_t base = static_cast<size_t>(nodeRow[ni]) * count;
+            double *cv = &counterValue[base];
+            unsigned char *last = &counterLast[base];
+            std::fill(scratchDouble.begin(), scratchDouble.end(), 0.0);
+            if (np.numInputs > 0) accumulatePort<double>(np.firstInput, scratchDouble.data());
+            for (size_t i = 0; i < count; ++i) {
+                const unsigned char now = scratchDouble[i] > 0.5 ? 1 : 0;
+                cv[i] += static_cast<double>(now & (last[i] ^ 1));
+                last[i] = now;
+            }
+            storeAll(cv);
+            break;
+        }
+        case FlowEngine::KernelTimer:
+            // Outputs are driven by tick()
+            break;
+        default:
+            // String kernels are rejected at load
+            break;
+    }
+}
+
+void BatchFlowEngine::execute() {
+    const FlowEngine::ExecPlan &plan = topo.plan;
+    if (coldStart) {
+        for (PortHandle h = 0; h < static_cast<PortHandle>(topo.portSlot.size()); ++h) propagateOutput(h);
+        std::fill(dirty.begin(), dirty.end(), 1);
+    }
+    for (int ni : plan.topoOrder) {
+        if (!dirty[ni]) continue;
+        dirty[ni] = 0;
+        evalNode(ni);
+    }
+    coldStart = false;
+}
+
+void BatchFlowEngine::tick(double dtMs) {
+    if (dtMs <= 0.0) return;
+    for (int ni : topo.plan.timerNodes) {
+        const double interval = topo.timerIntervalMs[ni];
+        if (interval <= 0.0) continue;
+        const PortHandle hOut = topo.plan.nodePorts[ni].firstOutput;
+        double *acc = &timerAccumMs[static_cast<size_t>(nodeRow[ni]) * count];
+        // Emit a one-tick pulse of 1 when the interval is reached, else hold 0
+        for (size_t i = 0; i < count; ++i) {
+            acc[i] += dtMs;
+            const bool fire = acc[i] >= interval;
+            acc[i] -= fire ? interval : 0.0;
+            scratchDouble[i] = fire ? 1.0 : 0.0;
+        }
+        // Any instance changing (pulse or 1->0 release) propagates the lane;
+        // pulses ignore the deadband, as in FlowEngine::tick
+        if (storePort(hOut, scratchDouble.data(), nullptr, 0.0)) {
+            propagateOutput(hOut);
+            markConsumers(hOut);
+        }
+    }
+}
+
+void BatchFlowEngine::setNodeValue(size_t instance, const std::string& nodeId, float value) {
+    if (instance >= count) return;
+    auto it = topo.nodeIndex.find(nodeId);
+    if (it == topo.nodeIndex.end()) return;
+    const int ni = static_cast<int>(it->second);
+    const unsigned char k = topo.plan.kernel[ni];
+    if (k != FlowEngine::KernelValue && k != FlowEngine::KernelDeviceTrigger) return;
+    const size_t idx = static_cast<size_t>(nodeRow[ni]) * count + instance;
+    paramValue[idx] = static_cast<double>(value);
+    paramSet[idx] = 1;
+    dirty[ni] = 1;
+}
+
+Value BatchFlowEngine::readPort(size_t instance, PortHandle handle) const {
+    if (instance >= count || handle < 0 || static_cast<size_t>(handle) >= topo.portSlot.size()) return Value{};
+    switch (topo.portSlot[handle].lane) {
+        case DType::Int:    return lanePtr<int>(handle)[instance];
+        case DType::Float:  return lanePtr<float>(handle)[instance];
+        case DType::Double: return lanePtr<double>(handle)[instance];
+        case DType::String: break;
+    }
+    return Value{};
+}
+
+} // namespace NodeFlow
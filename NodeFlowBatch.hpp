@@ -0,0 +1,80 @@
+// NodeFlow batched multi-instance engine
+//
+// Loads one graph topology and evaluates N independent instances of it in a
+// single pass. Every port is a contiguous array of N values in its declared
+// dtype lane (slot-major: slot * N + instance), so kernels (Add, Counter edge
+// detection, Timer accumulation) and edge casts are plain loops over
+// instances that the compiler can vectorize. Topology, descriptors and the
+// compiled execution plan are shared; only per-port values and per-node state
+// scale with N.
+#pragma once
+#include "NodeFlowCore.hpp"
+#include <vector>
+#include <string>
+
+namespace NodeFlow {
+
+class BatchFlowEngine {
+public:
+    BatchFlowEngine() = default;
+    // Load a graph and allocate state for `instances` copies of it. Throws on
+    // string ports (batch lanes are numeric only) and on anything FlowEngine
+    // rejects (unknown node types, bad connections, cycles).
+    void loadFromJson(const nlohmann::json& json, size_t instances);
+    size_t instanceCount() const { return count; }
+
+    // Evaluate all instances once; nodes are visited in topo order and only
+    // when dirty for at least one instance
+    void execute();
+    // Advance Timer nodes of every instance; dt in milliseconds
+    void tick(double dtMs);
+
+    // Per-instance control/readout (instance in [0, instanceCount()))
+    void setNodeValue(size_t instance, const std::string& nodeId, float value);
+    Value readPort(size_t instance, PortHandle handle) const;
+
+    // Introspection (shared by all instances)
+    const std::vector<NodeDesc>& getNodeDescs() const { return topo.getNodeDescs(); }
+    const std::vector<PortDesc>& getPortDescs() const { return topo.getPortDescs(); }
+    int getPortHandle(const std::string& nodeId, const std::string& portId, const std::string& direction) const {
+        return topo.getPortHandle(nodeId, portId, direction);
+    }
+
+private:
+    FlowEngine topo; // parsed graph and compiled plan; its own value lanes are unused
+    size_t count = 0;
+
+    // Port values, slot-major per lane
+    std::vector<int> laneInt;
+    std::vector<float> laneFloat;
+    std::vector<double> laneDouble;
+
+    // Per-node state rows (row * count + instance); nodeRow maps a node index
+    // to its row in the array matching its kernel, -1 when stateless
+    std::vector<int> nodeRow;
+    std::vector<double> paramValue;          // Value/DeviceTrigger: last set value
+    std::vector<unsigned char> paramSet;     // Value/DeviceTrigger: 1 once a value is known
+    std::vector<double> timerAccumMs;        // Timer accumulators
+    std::vector<double> counterValue;        // Counter counts
+    std::vector<unsigned char> counterLast;  // Counter last input level (edge detect)
+
+    std::vector<unsigned char> dirty;        // node index -> evaluate on next execute
+    std::vector<long long> scratchInt;       // per-instance accumulators (count-sized)
+    std::vector<float> scratchFloat;
+    std::vector<double> scratchDouble;
+    bool coldStart = true;
+
+    template <typename T> T* lanePtr(PortHandle h);
+    template <typename T> const T* lanePtr(PortHandle h) const;
+    // acc[i] += Load(port[i]) for every instance
+    template <typename Load, typename Acc> void accumulatePort(PortHandle h, Acc* acc) const;
+    // port[i] = src[i] cast to the port's lane for instances with known[i]
+    // (all when null) that moved more than `band`; returns true if any changed
+    template <typename S> bool storePort(PortHandle h, const S* src, const unsigned char* known, double band);
+    void propagateOutput(PortHandle hOut);
+    void evalNode(int ni);
+    // Mark the nodes fed by output hOut dirty
+    void markConsumers(PortHandle hOut);
+};
+
+} // namespace NodeFlow
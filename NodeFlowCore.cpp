@@ -4,6 +4,7 @@
 // and minimal AOT demo generation. The engine is moving toward a SoA layout
 // for high-performance deterministic evaluation.
 #include "NodeFlowCore.hpp"
+#include "NodeFlowShm.hpp"
 #include <fstream>
 #include <algorithm>
 #include <stdexcept>
@@ -13,6 +14,12 @@
 #include <random>
 #include <ctime>
 #include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <cmath>
+#include <limits>
 // headless-only; remove legacy TUI includes
 
 namespace NodeFlow {
@@ -147,84 +154,503 @@ void Node::execute(std::unordered_map<PortId, Value>& portValues) {
     }
 }
 
-// Load a graph from JSON and (re)build descriptors, topology, and adjacency
+namespace {
+
+// Numeric view of a parameter/port value (strings read as 0)
+double valueAsDouble(const Value& v) {
+    if (std::holds_alternative<double>(v)) return std::get<double>(v);
+    if (std::holds_alternative<float>(v)) return static_cast<double>(std::get<float>(v));
+    if (std::holds_alternative<int>(v)) return static_cast<double>(std::get<int>(v));
+    return 0.0;
+}
+
+// Work-stealing waves smaller than this run inline on the calling thread
+constexpr size_t kMinStealWave = 128;
+
+// Index of the lowest set bit (word must be non-zero)
+inline size_t lowestSetBit(unsigned long long word) {
+    return static_cast<size_t>(__builtin_ctzll(word));
+}
+
+} // namespace
+
+// Fixed pool for parallel execution. The calling thread participates as
+// worker 0, so a pool of N runs N - 1 background threads. runAll/parallelFor
+// return only after every participant has finished; that return is the barrier.
+struct WorkerPool {
+    explicit WorkerPool(int workers) : workerCount(workers) {
+        for (int w = 1; w < workers; ++w) threads.emplace_back([this, w]{ run(w); });
+    }
+    ~WorkerPool() {
+        { std::lock_guard<std::mutex> lk(m); stop = true; }
+        cvWork.notify_all();
+        for (auto &t : threads) t.join();
+    }
+    int size() const { return workerCount; }
+
+    // Run fn(worker) once on every participant
+    void runAll(const std::function<void(int)> &fn) {
+        if (threads.empty()) { fn(0); return; }
+        {
+            std::lock_guard<std::mutex> lk(m);
+            job = &fn;
+            active = static_cast<int>(threads.size());
+            ++epoch;
+        }
+        cvWork.notify_all();
+        fn(0);
+        std::unique_lock<std::mutex> lk(m);
+        cvDone.wait(lk, [this]{ return active == 0; });
+        job = nullptr;
+    }
+
+    // Run fn(i) for i in [0, count), handing out chunks to whoever is free
+    void parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+        if (threads.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        const size_t grain = std::max<size_t>(1, count / (static_cast<size_t>(workerCount) * 4));
+        std::atomic<size_t> next{0};
+        runAll([&](int) {
+            for (;;) {
+                const size_t i = next.fetch_add(grain, std::memory_order_relaxed);
+                if (i >= count) return;
+                const size_t e = std::min(count, i + grain);
+                for (size_t k = i; k < e; ++k) fn(k);
+            }
+        });
+    }
+
+private:
+    void run(int worker) {
+        unsigned long long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cvWork.wait(lk, [&]{ return stop || epoch != seen; });
+                if (stop) return;
+                seen = epoch;
+            }
+            (*job)(worker);
+            std::lock_guard<std::mutex> lk(m);
+            if (--active == 0) cvDone.notify_one();
+        }
+    }
+
+    int workerCount;
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable cvWork, cvDone;
+    unsigned long long epoch = 0;
+    bool stop = false;
+    int active = 0;
+    const std::function<void(int)> *job = nullptr;
+};
+
+// Per-worker task deque for the work-stealing executor. The owner pushes and
+// pops at the back (LIFO, cache-warm); thieves take from the front. Storage is
+// reused across waves, so steady state does not allocate.
+struct FlowEngine::StealDeque {
+    std::mutex m;
+    std::vector<int> items;
+    size_t head = 0;
+
+    void push(int ni) {
+        std::lock_guard<std::mutex> lk(m);
+        items.push_back(ni);
+    }
+    int pop() {
+        std::lock_guard<std::mutex> lk(m);
+        if (items.size() == head) return -1;
+        const int ni = items.back();
+        items.pop_back();
+        if (items.size() == head) { items.clear(); head = 0; }
+        return ni;
+    }
+    int steal() {
+        std::lock_guard<std::mutex> lk(m);
+        if (items.size() == head) return -1;
+        const int ni = items[head++];
+        if (items.size() == head) { items.clear(); head = 0; }
+        return ni;
+    }
+};
+
+InputQueue::InputQueue(size_t capacity) { reset(capacity); }
+
+void InputQueue::reset(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    cells.reset(new Cell[cap]);
+    mask = cap - 1;
+    for (size_t i = 0; i < cap; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    drops.store(0, std::memory_order_relaxed);
+}
+
+// A cell is free for position pos when its sequence equals pos, and holds the
+// command for pos once the producer publishes pos + 1
+bool InputQueue::push(const InputCommand& cmd) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &c = cells[pos & mask];
+        const size_t seq = c.seq.load(std::memory_order_acquire);
+        const long long dif = static_cast<long long>(seq) - static_cast<long long>(pos);
+        if (dif == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                c.cmd = cmd;
+                c.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            // Consumer has not freed this cell yet: ring is full
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool InputQueue::pop(InputCommand& out) {
+    const size_t pos = tail.load(std::memory_order_relaxed);
+    Cell &c = cells[pos & mask];
+    if (c.seq.load(std::memory_order_acquire) != pos + 1) return false;
+    out = c.cmd;
+    c.seq.store(pos + mask + 1, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t InputQueue::depth() const {
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t t = tail.load(std::memory_order_relaxed);
+    return h > t ? h - t : 0;
+}
+
+FlowEngine::FlowEngine() = default;
+FlowEngine::~FlowEngine() = default;
+
+DType dtypeFromString(const std::string& dataType) {
+    if (dataType == "int") return DType::Int;
+    if (dataType == "double") return DType::Double;
+    if (dataType == "string") return DType::String;
+    return DType::Float;
+}
+
+template <typename T>
+T FlowEngine::loadAs(PortHandle h) const {
+    const PortSlot ps = portSlot[h];
+    switch (ps.lane) {
+        case DType::Int:    return static_cast<T>(laneInt[ps.slot]);
+        case DType::Float:  return static_cast<T>(laneFloat[ps.slot]);
+        case DType::Double: return static_cast<T>(laneDouble[ps.slot]);
+        case DType::String: break;
+    }
+    return T{};
+}
+
+template <typename T>
+void FlowEngine::storeAs(PortHandle h, T v) {
+    const PortSlot ps = portSlot[h];
+    switch (ps.lane) {
+        case DType::Int:    laneInt[ps.slot] = static_cast<int>(v); break;
+        case DType::Float:  laneFloat[ps.slot] = static_cast<float>(v); break;
+        case DType::Double: laneDouble[ps.slot] = static_cast<double>(v); break;
+        case DType::String: laneString[ps.slot] = std::to_string(v); break;
+    }
+}
+
+// Store a kernel result into an output; only a value that actually changed
+// is stamped and pushed along the port's wires. Returns whether it changed.
+// A port with a deadband keeps its last propagated value until the new one
+// moves further than the band, so sub-band jitter schedules nothing.
+template <typename T>
+bool FlowEngine::storeOutput(PortHandle h, T v) {
+    const PortSlot ps = portSlot[h];
+    const double band = portDeadband[h];
+    auto moved = [band](double from, double to) { return band > 0.0 ? !(std::abs(to - from) <= band) : to != from; };
+    bool changed = false;
+    switch (ps.lane) {
+        case DType::Int: {
+            const int n = static_cast<int>(v);
+            changed = moved(laneInt[ps.slot], n);
+            if (changed) laneInt[ps.slot] = n;
+            break;
+        }
+        case DType::Float: {
+            const float f = static_cast<float>(v);
+            changed = moved(laneFloat[ps.slot], f);
+            if (changed) laneFloat[ps.slot] = f;
+            break;
+        }
+        case DType::Double: {
+            const double d = static_cast<double>(v);
+            changed = moved(laneDouble[ps.slot], d);
+            if (changed) laneDouble[ps.slot] = d;
+            break;
+        }
+        case DType::String:
+            return storeOutputString(h, std::to_string(v));
+    }
+    if (changed) {
+        markChanged(h, evalGeneration);
+        propagateOutput(h);
+    }
+    return changed;
+}
+
+bool FlowEngine::storeOutputString(PortHandle h, const std::string& v) {
+    std::string &cur = laneString[portSlot[h].slot];
+    if (cur == v) return false;
+    cur = v;
+    markChanged(h, evalGeneration);
+    propagateOutput(h);
+    return true;
+}
+
+FlowEngine::PortSlot FlowEngine::allocateSlot(DType lane) {
+    switch (lane) {
+        case DType::Int:    laneInt.push_back(0);       return {lane, static_cast<unsigned int>(laneInt.size() - 1)};
+        case DType::Double: laneDouble.push_back(0.0);  return {lane, static_cast<unsigned int>(laneDouble.size() - 1)};
+        case DType::String: laneString.emplace_back();  return {lane, static_cast<unsigned int>(laneString.size() - 1)};
+        case DType::Float:  break;
+    }
+    laneFloat.push_back(0.0f);
+    return {DType::Float, static_cast<unsigned int>(laneFloat.size() - 1)};
+}
+
+Value FlowEngine::readPort(PortHandle handle) const {
+    if (handle < 0 || static_cast<size_t>(handle) >= portSlot.size()) return Value{};
+    const PortSlot ps = portSlot[handle];
+    switch (ps.lane) {
+        case DType::Int:    return laneInt[ps.slot];
+        case DType::Float:  return laneFloat[ps.slot];
+        case DType::Double: return laneDouble[ps.slot];
+        case DType::String: return laneString[ps.slot];
+    }
+    return Value{};
+}
+
+void FlowEngine::writePort(PortHandle handle, const Value& v) {
+    if (handle < 0 || static_cast<size_t>(handle) >= portSlot.size()) return;
+    ++publishEpoch; // unstamped write
+    if (portSlot[handle].lane == DType::String) {
+        if (std::holds_alternative<std::string>(v)) laneString[portSlot[handle].slot] = std::get<std::string>(v);
+        return;
+    }
+    storeAs<double>(handle, valueAsDouble(v));
+}
+
+void FlowEngine::resolveKernel(int ni) {
+    const Node &node = nodes[ni];
+    const NodePorts &np = plan.nodePorts[ni];
+    const DType outLane = (np.numOutputs > 0) ? portSlot[np.firstOutput].lane : DType::Float;
+    const bool stringOut = (outLane == DType::String);
+    Kernel k;
+    if (node.type == "Value") {
+        k = stringOut ? KernelValueString : KernelValue;
+    } else if (node.type == "DeviceTrigger") {
+        k = stringOut ? KernelDeviceTriggerString : KernelDeviceTrigger;
+    } else if (node.type == "Add") {
+        switch (outLane) {
+            case DType::Int:    k = KernelAddInt; break;
+            case DType::Double: k = KernelAddDouble; break;
+            case DType::String: k = KernelAddString; break;
+            default:            k = KernelAddFloat; break;
+        }
+    } else if (node.type == "Counter") {
+        k = KernelCounter;
+    } else if (node.type == "Timer") {
+        k = KernelTimer;
+        if (np.numOutputs > 0) plan.timerNodes.push_back(ni);
+    } else {
+        throw std::runtime_error("Unknown node type: " + node.type + " (node " + node.id + ")");
+    }
+    if (plan.kernel.size() <= static_cast<size_t>(ni)) {
+        plan.kernel.resize(ni + 1);
+        nodeParam.resize(ni + 1);
+        nodeParamSet.resize(ni + 1);
+        timerIntervalMs.resize(ni + 1);
+    }
+    plan.kernel[ni] = k;
+    auto p = node.parameters.find("value");
+    nodeParamSet[ni] = (p != node.parameters.end()) ? 1 : 0;
+    nodeParam[ni] = nodeParamSet[ni] ? valueAsDouble(p->second) : 0.0;
+    auto iv = node.parameters.find("interval_ms");
+    timerIntervalMs[ni] = (k == KernelTimer && iv != node.parameters.end()) ? valueAsDouble(iv->second) : 0.0;
+}
+
+// Parse one node and append its descriptors, handles, lane slots and kernel.
+// Nothing is appended if the JSON is malformed, the id is taken, or the type
+// is unknown.
+int FlowEngine::appendNode(const nlohmann::json& nodeJson) {
+    Node node;
+    node.id = nodeJson["id"].get<std::string>();
+    node.type = nodeJson["type"].get<std::string>();
+
+    for (const auto& input : nodeJson["inputs"]) {
+        node.inputs.push_back({input["id"].get<std::string>(), "input", input["type"].get<std::string>(), Value{0.0f}});
+    }
+    for (const auto& output : nodeJson["outputs"]) {
+        node.outputs.push_back({output["id"].get<std::string>(), "output", output["type"].get<std::string>(), Value{0.0f}});
+        if (output.contains("deadband")) {
+            const double band = output["deadband"].get<double>();
+            if (!(band >= 0.0)) throw std::runtime_error("Invalid deadband on " + node.id + ":" + node.outputs.back().id);
+            node.outputs.back().deadband = band;
+        }
+    }
+    if (nodeJson.contains("parameters") && nodeJson["parameters"].is_object()) {
+    for (const auto& param : nodeJson["parameters"].items()) {
+            // Use the actual JSON type for parameters (keys may be strings even if outputs are numeric)
+            if (param.value().is_string()) {
+                node.parameters[param.key()] = param.value().get<std::string>();
+            } else if (param.value().is_number_integer()) {
+                node.parameters[param.key()] = param.value().get<int>();
+            } else if (param.value().is_number_float()) {
+                // store as double to preserve precision; execution code handles double and float
+                node.parameters[param.key()] = param.value().get<double>();
+            } else if (param.value().is_boolean()) {
+                node.parameters[param.key()] = param.value().get<bool>() ? 1 : 0;
+            }
+        }
+    }
+    if (!nodeIndex.emplace(node.id, nodes.size()).second) {
+        throw std::runtime_error("Duplicate node id: " + node.id);
+    }
+    // Build descriptors and handles as we go; a node's ports get
+    // contiguous handles (inputs first, then outputs)
+    const int ni = static_cast<int>(nodes.size());
+    NodeDesc nd; nd.id = node.id; nd.type = node.type;
+    NodePorts np;
+    np.firstInput = static_cast<PortHandle>(portDescs.size());
+    np.numInputs = static_cast<int>(node.inputs.size());
+    for (const auto& ip : node.inputs) {
+        std::string key = node.id + ":" + ip.id + ":input";
+        PortHandle h = static_cast<PortHandle>(portDescs.size());
+        portKeyToHandle[key] = h;
+        portDescs.push_back({h, node.id, ip.id, "input", ip.dataType});
+        portSlot.push_back(allocateSlot(dtypeFromString(ip.dataType)));
+        portChangedStamp.push_back(0);
+        portDeadband.push_back(0.0);
+        portLoggedStamp.push_back(0);
+        plan.portNode.push_back(ni);
+        nd.inputPorts.push_back(h);
+    }
+    np.firstOutput = static_cast<PortHandle>(portDescs.size());
+    np.numOutputs = static_cast<int>(node.outputs.size());
+    for (const auto& op : node.outputs) {
+        std::string key = node.id + ":" + op.id + ":output";
+        PortHandle h = static_cast<PortHandle>(portDescs.size());
+        portKeyToHandle[key] = h;
+        portDescs.push_back({h, node.id, op.id, "output", op.dataType});
+        portDescs.back().deadband = op.deadband;
+        portSlot.push_back(allocateSlot(dtypeFromString(op.dataType)));
+        portChangedStamp.push_back(0);
+        portDeadband.push_back(op.deadband);
+        portLoggedStamp.push_back(0);
+        plan.portNode.push_back(ni);
+        nd.outputPorts.push_back(h);
+    }
+    plan.nodePorts.push_back(np);
+    nodeDescs.push_back(std::move(nd));
+    nodes.push_back(node);
+    try {
+        resolveKernel(ni);
+    } catch (...) {
+        // Unknown type: undo the append (the lane slots stay allocated, unused)
+        for (size_t h = np.firstInput; h < portDescs.size(); ++h) {
+            portKeyToHandle.erase(node.id + ":" + portDescs[h].portId + ":" + portDescs[h].direction);
+        }
+        portDescs.resize(np.firstInput);
+        portSlot.resize(np.firstInput);
+        portChangedStamp.resize(np.firstInput);
+        portDeadband.resize(np.firstInput);
+        portLoggedStamp.resize(np.firstInput);
+        plan.portNode.resize(np.firstInput);
+        plan.nodePorts.pop_back();
+        nodeDescs.pop_back();
+        nodes.pop_back();
+        nodeIndex.erase(node.id);
+        throw;
+    }
+    return ni;
+}
+
+std::pair<PortHandle, PortHandle> FlowEngine::resolveConnection(const Connection& conn) const {
+    int hOut = getPortHandle(conn.fromNode, conn.fromPort, "output");
+    int hIn = getPortHandle(conn.toNode, conn.toPort, "input");
+    if (hOut < 0 || hIn < 0) {
+        throw std::runtime_error("Unknown port in connection: " + conn.fromNode + ":" + conn.fromPort + " -> " + conn.toNode + ":" + conn.toPort);
+    }
+    auto isNumeric = [](const std::string &t){ return t=="int" || t=="float" || t=="double"; };
+    const std::string &fromT = portDescs[hOut].dataType;
+    const std::string &toT = portDescs[hIn].dataType;
+    // Allow numeric coercion (int/float/double); only reject if one is non-numeric or they differ in kind
+    if (!(isNumeric(fromT) && isNumeric(toT))) {
+        if (fromT != toT) throw std::runtime_error("Type mismatch in connection");
+    }
+    return {hOut, hIn};
+}
+
+// Wire entry with the lane-to-lane cast resolved up front
+FlowEngine::EdgeTarget FlowEngine::edgeTarget(PortHandle hOut, PortHandle hIn) const {
+    const DType src = portSlot[hOut].lane;
+    const DType dst = portSlot[hIn].lane;
+    EdgeTarget t;
+    t.input = hIn;
+    t.slot = portSlot[hIn].slot;
+    t.cast = (src == DType::String) ? static_cast<unsigned char>(StringToString)
+           : static_cast<unsigned char>(static_cast<int>(src) * 3 + static_cast<int>(dst));
+    return t;
+}
+
+// Load a graph from JSON and (re)build descriptors, topology, and the
+// integer-indexed execution plan used by the hot path
 void FlowEngine::loadFromJson(const nlohmann::json& json) {
     srand(time(NULL));
+    ++publishEpoch;
     nodes.clear();
     connections.clear();
     nodeDescs.clear();
     portDescs.clear();
     portKeyToHandle.clear();
     portChangedStamp.clear();
-    portValues.clear();
-    outToIn.clear();
-    nodeOutputHandles.clear();
-
-    for (const auto& nodeJson : json["nodes"]) {
-        Node node;
-        node.id = nodeJson["id"].get<std::string>();
-        node.type = nodeJson["type"].get<std::string>();
-
-        for (const auto& input : nodeJson["inputs"]) {
-            node.inputs.push_back({input["id"].get<std::string>(), "input", input["type"].get<std::string>(), Value{0.0f}});
-        }
-        for (const auto& output : nodeJson["outputs"]) {
-            node.outputs.push_back({output["id"].get<std::string>(), "output", output["type"].get<std::string>(), Value{0.0f}});
-        }
-        if (nodeJson.contains("parameters") && nodeJson["parameters"].is_object()) {
-        for (const auto& param : nodeJson["parameters"].items()) {
-                // Use the actual JSON type for parameters (keys may be strings even if outputs are numeric)
-                if (param.value().is_string()) {
-                    node.parameters[param.key()] = param.value().get<std::string>();
-                } else if (param.value().is_number_integer()) {
-                    node.parameters[param.key()] = param.value().get<int>();
-                } else if (param.value().is_number_float()) {
-                    // store as double to preserve precision; execution code handles double and float
-                    node.parameters[param.key()] = param.value().get<double>();
-                } else if (param.value().is_boolean()) {
-                    node.parameters[param.key()] = param.value().get<bool>() ? 1 : 0;
-                }
-            }
-        }
-        // Build descriptors and handles as we go
-        NodeDesc nd; nd.id = node.id; nd.type = node.type;
-        for (const auto& ip : node.inputs) {
-            std::string key = node.id + ":" + ip.id + ":input";
-            PortHandle h = static_cast<PortHandle>(portDescs.size());
-            portKeyToHandle[key] = h;
-            portDescs.push_back({h, node.id, ip.id, "input", ip.dataType});
-            portChangedStamp.push_back(0);
-            nd.inputPorts.push_back(h);
-        }
-        for (const auto& op : node.outputs) {
-            std::string key = node.id + ":" + op.id + ":output";
-            PortHandle h = static_cast<PortHandle>(portDescs.size());
-            portKeyToHandle[key] = h;
-            portDescs.push_back({h, node.id, op.id, "output", op.dataType});
-            portChangedStamp.push_back(0);
-            nd.outputPorts.push_back(h);
-        }
-        nodeDescs.push_back(std::move(nd));
-        nodes.push_back(node);
-    }
-    portValues.resize(portDescs.size());
-    outToIn.resize(portDescs.size());
-
-    // Build handle adjacency and node->output handles map
-    for (const auto &n : nodes) {
-        std::vector<PortHandle> outs;
-        for (const auto &op : n.outputs) {
-            int h = getPortHandle(n.id, op.id, "output");
-            if (h >= 0) outs.push_back(h);
-        }
-        nodeOutputHandles[n.id] = std::move(outs);
-    }
-    for (const auto &c : connections) {
-        int hOut = getPortHandle(c.fromNode, c.fromPort, "output");
-        int hIn  = getPortHandle(c.toNode, c.toPort, "input");
-        if (hOut >= 0 && hIn >= 0) outToIn[hOut].push_back(hIn);
+    portDeadband.clear();
+    portLoggedStamp.clear();
+    changeLog.clear();
+    portSlot.clear();
+    laneInt.clear();
+    laneFloat.clear();
+    laneDouble.clear();
+    laneString.clear();
+    nodeIndex.clear();
+    nodeParam.clear();
+    nodeParamSet.clear();
+    timerIntervalMs.clear();
+    plan = ExecPlan{};
+    removedNodes = 0;
+    // Queued handles refer to the previous graph, in the queue and in the
+    // --shm-in ring alike (records pushed after this point are kept)
+    for (InputCommand stale; inputQueue.pop(stale);) {}
+    if (inputRing) {
+        nodeflow_shm_record stale;
+        for (size_t n = inputRing->depth(); n > 0 && inputRing->pop(stale); --n) {}
     }
+    inputMark.clear();
+    inputLatest.clear();
+    inputStampNs.clear();
+    readyBits.clear();
+    legacyQueue.clear();
+    readyCursor = 0;
+    readyCount = 0;
+    coldStart = true;
 
+    for (const auto& nodeJson : json["nodes"]) appendNode(nodeJson);
+
+    std::vector<std::pair<PortHandle, PortHandle>> edges;
     for (const auto& connJson : json["connections"]) {
         Connection conn = {
             connJson["fromNode"].get<std::string>(),
@@ -232,44 +658,101 @@ void FlowEngine::loadFromJson(const nlohmann::json& json) {
             connJson["toNode"].get<std::string>(),
             connJson["toPort"].get<std::string>()
         };
-        auto fromNode = std::find_if(nodes.begin(), nodes.end(), [&](const Node& n) { return n.id == conn.fromNode; });
-        auto toNode = std::find_if(nodes.begin(), nodes.end(), [&](const Node& n) { return n.id == conn.toNode; });
-        auto fromPort = std::find_if(fromNode->outputs.begin(), fromNode->outputs.end(),
-                                     [&](const Port& p) { return p.id == conn.fromPort; });
-        auto toPort = std::find_if(toNode->inputs.begin(), toNode->inputs.end(),
-                                   [&](const Port& p) { return p.id == conn.toPort; });
-        auto isNumeric = [](const std::string &t){ return t=="int" || t=="float" || t=="double"; };
-        const std::string &fromT = fromPort->dataType;
-        const std::string &toT = toPort->dataType;
-        // Allow numeric coercion (int/float/double); only reject if one is non-numeric or they differ in kind
-        if (!(isNumeric(fromT) && isNumeric(toT))) {
-            if (fromT != toT) throw std::runtime_error("Type mismatch in connection");
-        }
+        const auto hs = resolveConnection(conn);
         connections.push_back(conn);
+        edges.push_back(hs);
+        std::cout << "[DEBUG] connect " << conn.fromNode << ":" << conn.fromPort << "(hOut=" << hs.first << ") -> "
+                  << conn.toNode << ":" << conn.toPort << "(hIn=" << hs.second << ")\n";
+    }
+
+    // Pack output -> input rows sized exactly (rows keep connection order)
+    std::vector<int> rowSize(portDescs.size(), 0);
+    for (const auto &e : edges) ++rowSize[e.first];
+    plan.outToIn.build(rowSize);
+    plan.inputWires.assign(portDescs.size(), 0);
+    for (const auto &e : edges) {
+        plan.outToIn.push(e.first, edgeTarget(e.first, e.second));
+        // Parallel execution needs each input written by exactly one wire
+        if (++plan.inputWires[e.second] == 2) ++plan.multiFedInputs;
+    }
+
+    // Pack node -> downstream nodes, collapsing parallel wires into one entry
+    rowSize.assign(nodes.size(), 0);
+    for (const auto &e : edges) ++rowSize[plan.portNode[e.first]];
+    plan.dependents.build(rowSize);
+    {
+        std::vector<int> seen(nodes.size(), -1);
+        std::vector<int> entry(nodes.size(), 0);
+        for (size_t ni = 0; ni < nodes.size(); ++ni) {
+            const NodePorts &np = plan.nodePorts[ni];
+            for (PortHandle h = np.firstOutput; h < np.firstOutput + np.numOutputs; ++h) {
+                for (int e = plan.outToIn.begin(h); e < plan.outToIn.end(h); ++e) {
+                    int dn = plan.portNode[plan.outToIn.items[e].input];
+                    if (seen[dn] == (int)ni) { ++plan.dependents.items[entry[dn]].wires; continue; }
+                    seen[dn] = (int)ni;
+                    entry[dn] = plan.dependents.end(static_cast<int>(ni));
+                    plan.dependents.push(static_cast<int>(ni), DependentEdge{dn, 1});
+                }
+            }
+        }
+    }
+    // Reverse rows for the backward search of incremental reordering
+    rowSize.assign(nodes.size(), 0);
+    for (const auto &d : plan.dependents.items) ++rowSize[d.node];
+    plan.precedents.build(rowSize);
+    for (size_t ni = 0; ni < nodes.size(); ++ni) {
+        for (int e = plan.dependents.begin(static_cast<int>(ni)); e < plan.dependents.end(static_cast<int>(ni)); ++e) {
+            const DependentEdge &d = plan.dependents.items[e];
+            plan.precedents.push(d.node, DependentEdge{static_cast<int>(ni), d.wires});
+        }
     }
 
     computeExecutionOrder();
+}
 
-    // Rebuild handle adjacency now that connections are populated
-    outToIn.clear();
-    outToIn.resize(portDescs.size());
-    nodeOutputHandles.clear();
-    for (const auto &n : nodes) {
-        std::vector<PortHandle> outs;
-        for (const auto &op : n.outputs) {
-            int h = getPortHandle(n.id, op.id, "output");
-            if (h >= 0) outs.push_back(h);
+// Add a wire to the plan: output row, input fan-in and the dependents entry
+void FlowEngine::linkEdge(PortHandle hOut, PortHandle hIn) {
+    plan.outToIn.push(hOut, edgeTarget(hOut, hIn));
+    if (++plan.inputWires[hIn] == 2) ++plan.multiFedInputs;
+    const int u = plan.portNode[hOut];
+    const int v = plan.portNode[hIn];
+    for (int e = plan.dependents.begin(u); e < plan.dependents.end(u); ++e) {
+        if (plan.dependents.items[e].node == v) {
+            ++plan.dependents.items[e].wires;
+            for (int p = plan.precedents.begin(v); p < plan.precedents.end(v); ++p) {
+                if (plan.precedents.items[p].node == u) { ++plan.precedents.items[p].wires; break; }
+            }
+            return;
         }
-        nodeOutputHandles[n.id] = std::move(outs);
     }
-    for (const auto &c : connections) {
-        int hOut = getPortHandle(c.fromNode, c.fromPort, "output");
-        int hIn  = getPortHandle(c.toNode, c.toPort, "input");
-        if (hOut >= 0 && hIn >= 0) outToIn[hOut].push_back(hIn);
-        std::cout << "[DEBUG] connect " << c.fromNode << ":" << c.fromPort << "(hOut=" << hOut << ") -> "
-                  << c.toNode << ":" << c.toPort << "(hIn=" << hIn << ")\n";
+    plan.dependents.push(u, DependentEdge{v, 1});
+    plan.precedents.push(v, DependentEdge{u, 1});
+}
+
+void FlowEngine::unlinkEdge(PortHandle hOut, PortHandle hIn) {
+    for (int e = plan.outToIn.begin(hOut); e < plan.outToIn.end(hOut); ++e) {
+        if (plan.outToIn.items[e].input == hIn) { plan.outToIn.eraseAt(hOut, e); break; }
     }
+    if (plan.inputWires[hIn]-- == 2) --plan.multiFedInputs;
+    const int u = plan.portNode[hOut];
+    const int v = plan.portNode[hIn];
+    for (int e = plan.dependents.begin(u); e < plan.dependents.end(u); ++e) {
+        if (plan.dependents.items[e].node == v) {
+            if (--plan.dependents.items[e].wires == 0) plan.dependents.eraseAt(u, e);
+            break;
+        }
+    }
+    for (int e = plan.precedents.begin(v); e < plan.precedents.end(v); ++e) {
+        if (plan.precedents.items[e].node == u) {
+            if (--plan.precedents.items[e].wires == 0) plan.precedents.eraseAt(v, e);
+            break;
+        }
+    }
+    plan.outToIn.compactIfSparse();
+    plan.dependents.compactIfSparse();
+    plan.precedents.compactIfSparse();
 }
+
 int FlowEngine::getPortHandle(const std::string& nodeId, const std::string& portId, const std::string& direction) const {
     auto it = portKeyToHandle.find(nodeId + ":" + portId + ":" + direction);
     if (it == portKeyToHandle.end()) return -1;
@@ -277,276 +760,493 @@ int FlowEngine::getPortHandle(const std::string& nodeId, const std::string& port
 }
 
 void FlowEngine::computeExecutionOrder() {
-    executionOrder.clear();
-    std::unordered_map<NodeId, std::vector<NodeId>> graph;
-    std::unordered_map<NodeId, int> inDegree;
+    plan.topoOrder.clear();
+    plan.topoIndex.clear();
+    orderNodes();
 
-    for (const auto& node : nodes) {
-        inDegree[node.id] = 0;
+    // Resize per-node scheduling state and Timer/Counter state
+    readyBits.assign((nodes.size() + 63) / 64, 0);
+    legacyQueue.clear();
+    readyCursor = readyBits.size();
+    readyCount = 0;
+    waveCapacity = 0;
+    waveMark.clear();
+    timerHeap.clear();
+    timerClockMs = 0.0;
+    timerBaseMs.assign(nodes.size(), 0.0);
+    timerArm.assign(nodes.size(), 0);
+    timerPulsing.clear();
+    counterLastTick.assign(nodes.size(), 0);
+    counterValue.assign(nodes.size(), 0.0);
+    growNodeState();
+    for (int ni : plan.timerNodes) armTimer(ni);
+}
+
+void FlowEngine::orderNodes() {
+    const int n = static_cast<int>(nodes.size());
+    std::vector<int> inDegree(n, 0);
+    for (int ni = 0; ni < n; ++ni) {
+        for (int e = plan.dependents.begin(ni); e < plan.dependents.end(ni); ++e) ++inDegree[plan.dependents.items[e].node];
     }
-    for (const auto& conn : connections) {
-        graph[conn.fromNode].push_back(conn.toNode);
-        inDegree[conn.toNode]++;
+
+    // Kahn's algorithm over live node indices; the queue is consumed by cursor
+    // so the pass stays linear in nodes + edges
+    std::vector<int> order;
+    order.reserve(n - removedNodes);
+    for (int i = 0; i < n; ++i) if (inDegree[i] == 0 && !nodeDescs[i].removed) order.push_back(i);
+    for (size_t head = 0; head < order.size(); ++head) {
+        int cur = order[head];
+        for (int e = plan.dependents.begin(cur); e < plan.dependents.end(cur); ++e) {
+            int next = plan.dependents.items[e].node;
+            if (--inDegree[next] == 0) order.push_back(next);
+        }
     }
 
-    std::vector<NodeId> queue;
-    for (const auto& node : nodes) {
-        if (inDegree[node.id] == 0) {
-            queue.push_back(node.id);
+    if (order.size() != nodes.size() - removedNodes) {
+        // Nodes Kahn never released sit on (or downstream of) a cycle
+        for (int i = 0; i < n; ++i) {
+            if (inDegree[i] > 0 && !nodeDescs[i].removed) throw std::runtime_error("Cycle detected in flow graph at node " + nodes[i].id);
         }
+        throw std::runtime_error("Cycle detected in flow graph");
     }
 
-    while (!queue.empty()) {
-        auto current = queue.front();
-        queue.erase(queue.begin());
-        executionOrder.push_back(current);
+    // Group into dependency levels (longest path from a source) and reorder
+    // level-major; stable within a level, so this is still a Kahn order and
+    // each level is a contiguous range of topo positions
+    std::vector<int> level(n, 0);
+    int numLevels = order.empty() ? 0 : 1;
+    for (int cur : order) {
+        for (int e = plan.dependents.begin(cur); e < plan.dependents.end(cur); ++e) {
+            int next = plan.dependents.items[e].node;
+            if (level[cur] + 1 > level[next]) level[next] = level[cur] + 1;
+        }
+        if (level[cur] + 1 > numLevels) numLevels = level[cur] + 1;
+    }
+    plan.levelOffsets.assign(numLevels + 1, 0);
+    for (int cur : order) ++plan.levelOffsets[level[cur] + 1];
+    for (int l = 0; l < numLevels; ++l) plan.levelOffsets[l + 1] += plan.levelOffsets[l];
 
-        for (const auto& next : graph[current]) {
-            if (--inDegree[next] == 0) {
-                queue.push_back(next);
-            }
+    // Nodes pending in the ready set keep their membership at the new positions
+    std::vector<int> pending;
+    if (readyCount > 0) {
+        for (size_t w = 0; w < readyBits.size(); ++w) {
+            for (unsigned long long b = readyBits[w]; b; b &= b - 1) pending.push_back(plan.topoOrder[(w << 6) + lowestSetBit(b)]);
         }
     }
+    {
+        std::vector<int> cursor(plan.levelOffsets.begin(), plan.levelOffsets.end() - 1);
+        plan.topoOrder.assign(order.size(), 0);
+        for (int cur : order) plan.topoOrder[cursor[level[cur]]++] = cur;
+    }
 
-    if (executionOrder.size() != nodes.size()) {
-        throw std::runtime_error("Cycle detected in flow graph");
+    plan.topoIndex.assign(n, -1);
+    executionOrder.clear();
+    executionOrder.reserve(plan.topoOrder.size());
+    for (size_t pos = 0; pos < plan.topoOrder.size(); ++pos) {
+        plan.topoIndex[plan.topoOrder[pos]] = static_cast<int>(pos);
+        executionOrder.push_back(nodes[plan.topoOrder[pos]].id);
     }
+    plan.levelsDirty = false;
 
-    // Build topo index and dependents
-    topoIndex.clear();
-    nodeIndex.clear();
-    dependents = graph;
-    for (size_t i = 0; i < executionOrder.size(); ++i) topoIndex[executionOrder[i]] = static_cast<int>(i);
-    for (size_t i = 0; i < nodes.size(); ++i) nodeIndex[nodes[i].id] = i;
+    if (!pending.empty()) {
+        std::fill(readyBits.begin(), readyBits.end(), 0ull);
+        readyCursor = readyBits.size();
+        for (int ni : pending) {
+            const size_t pos = static_cast<size_t>(plan.topoIndex[ni]);
+            readyBits[pos >> 6] |= 1ull << (pos & 63);
+            if ((pos >> 6) < readyCursor) readyCursor = pos >> 6;
+        }
+        if (scheduler == Scheduler::LegacyQueue) {
+            std::stable_sort(legacyQueue.begin(), legacyQueue.end(), [&](int a, int b){
+                return plan.topoIndex[a] < plan.topoIndex[b];
+            });
+        }
+    }
+}
 
-    // Resize per-node state for Timer/Counter
-    timerAccumMs.assign(nodes.size(), 0.0);
-    counterLastTick.assign(nodes.size(), 0);
-    counterValue.assign(nodes.size(), 0.0);
+// Grow per-node state to cover every node index; existing entries keep
+// their values (load resets them first in computeExecutionOrder)
+void FlowEngine::growNodeState() {
+    const size_t n = nodes.size();
+    readyBits.resize((plan.topoOrder.size() + 63) / 64, 0);
+    waveMark.resize(n, 0);
+    orderMark.resize(n, 0);
+    timerBaseMs.resize(n, timerClockMs);
+    timerArm.resize(n, 0);
+    counterLastTick.resize(n, 0);
+    counterValue.resize(n, 0.0);
+    if (n > waveCapacity) {
+        // Wave arrays are reinitialised per wave, so nothing is copied
+        waveCapacity = std::max(n, waveCapacity * 2);
+        wavePending.reset(new std::atomic<int>[waveCapacity]);
+        waveDirty.reset(new std::atomic<unsigned char>[waveCapacity]);
+    }
 }
 
-// Evaluate the graph once (non-blocking). Seeds previous outputs, performs
-// handle-based propagation, and executes nodes in topological order.
-void FlowEngine::execute() {
-    auto t0 = std::chrono::steady_clock::now();
-    // bump evaluation generation
-    ++evalGeneration;
+void FlowEngine::addNode(const nlohmann::json& nodeJson) {
+    ++publishEpoch;
+    const int ni = appendNode(nodeJson);
+    const NodePorts &np = plan.nodePorts[ni];
+    for (int k = 0; k < np.numInputs + np.numOutputs; ++k) {
+        plan.outToIn.addRow();
+        plan.inputWires.push_back(0);
+    }
+    plan.dependents.addRow();
+    plan.precedents.addRow();
+    // No wires yet, so the end of the topo order is a valid position
+    plan.topoIndex.push_back(static_cast<int>(plan.topoOrder.size()));
+    plan.topoOrder.push_back(ni);
+    executionOrder.push_back(nodes[ni].id);
+    plan.levelsDirty = true;
+    growNodeState();
+    if (plan.kernel[ni] == KernelTimer) armTimer(ni);
+    enqueueNode(ni);
+}
 
-    auto makeKey = [](const std::string& nodeId, const std::string& portId) { return nodeId + ":" + portId; };
-    // Only on cold start do we seed SoA and perform initial propagation; subsequent ticks are dirty-driven
-    if (coldStart) {
-        for (const auto& node : nodes) {
-            for (const auto& output : node.outputs) {
-                int hOut = getPortHandle(node.id, output.id, "output");
-                if (hOut >= 0 && static_cast<size_t>(hOut) < portValues.size()) this->portValues[hOut] = output.value;
-            }
+void FlowEngine::connect(const Connection& c) {
+    ++publishEpoch;
+    const auto hs = resolveConnection(c);
+    const int u = plan.portNode[hs.first];
+    const int v = plan.portNode[hs.second];
+    linkEdge(hs.first, hs.second);
+    // Back edge against the current order: repair locally, or undo on a cycle
+    try {
+        reorderForEdge(u, v, c);
+    } catch (...) {
+        unlinkEdge(hs.first, hs.second);
+        throw;
+    }
+    connections.push_back(c);
+    plan.levelsDirty = true;
+    propagateOutput(hs.first);
+    enqueueNode(v);
+}
+
+void FlowEngine::reorderForEdge(int u, int v, const Connection& c) {
+    const int lb = plan.topoIndex[v];
+    const int ub = plan.topoIndex[u];
+    if (lb > ub) return; // already consistent
+
+    // Forward search from v over positions below ub; reaching u closes a cycle
+    orderFwd.clear();
+    orderStack.assign(1, v);
+    orderMark[v] = 1;
+    bool cycle = false;
+    while (!orderStack.empty() && !cycle) {
+        const int w = orderStack.back();
+        orderStack.pop_back();
+        orderFwd.push_back(w);
+        for (int e = plan.dependents.begin(w); e < plan.dependents.end(w); ++e) {
+            const int x = plan.dependents.items[e].node;
+            if (x == u) { cycle = true; break; }
+            if (!orderMark[x] && plan.topoIndex[x] < ub) { orderMark[x] = 1; orderStack.push_back(x); }
         }
-        for (const auto &pd : portDescs) {
-            if (pd.direction != "output") continue;
-            int hOut = pd.handle;
-            for (int hIn : outToIn[hOut]) {
-                if (hIn >= 0 && static_cast<size_t>(hIn) < portValues.size()) {
-                    this->portValues[hIn] = this->portValues[hOut];
-                    (void)portDescs; // SoA propagation only; map no longer used
-                }
+    }
+    if (cycle) {
+        for (int w : orderFwd) orderMark[w] = 0;
+        for (int w : orderStack) orderMark[w] = 0;
+        throw std::runtime_error("Cycle detected in flow graph at connection " + c.fromNode + ":" + c.fromPort + " -> " + c.toNode + ":" + c.toPort);
+    }
+
+    // Backward search from u over positions above lb
+    orderBwd.clear();
+    orderStack.assign(1, u);
+    orderMark[u] = 1;
+    while (!orderStack.empty()) {
+        const int w = orderStack.back();
+        orderStack.pop_back();
+        orderBwd.push_back(w);
+        for (int e = plan.precedents.begin(w); e < plan.precedents.end(w); ++e) {
+            const int y = plan.precedents.items[e].node;
+            if (!orderMark[y] && plan.topoIndex[y] > lb) { orderMark[y] = 1; orderStack.push_back(y); }
+        }
+    }
+
+    // Reuse the affected positions: everything reaching u, then everything
+    // reachable from v, each group keeping its relative order
+    auto byPos = [&](int a, int b){ return plan.topoIndex[a] < plan.topoIndex[b]; };
+    std::sort(orderBwd.begin(), orderBwd.end(), byPos);
+    std::sort(orderFwd.begin(), orderFwd.end(), byPos);
+    orderSlots.clear();
+    bool movedReady = false;
+    for (const auto *group : {&orderBwd, &orderFwd}) {
+        for (int w : *group) {
+            const size_t pos = static_cast<size_t>(plan.topoIndex[w]);
+            orderSlots.push_back(static_cast<int>(pos));
+            orderMark[w] = 0;
+            // Ready bits follow their node; mark 2 records membership until re-set
+            const unsigned long long bit = 1ull << (pos & 63);
+            if (readyBits[pos >> 6] & bit) { readyBits[pos >> 6] &= ~bit; orderMark[w] = 2; }
+        }
+    }
+    std::sort(orderSlots.begin(), orderSlots.end());
+    size_t k = 0;
+    for (const auto *group : {&orderBwd, &orderFwd}) {
+        for (int w : *group) {
+            const int pos = orderSlots[k++];
+            plan.topoOrder[pos] = w;
+            plan.topoIndex[w] = pos;
+            if (orderMark[w] == 2) {
+                readyBits[static_cast<size_t>(pos) >> 6] |= 1ull << (pos & 63);
+                if ((static_cast<size_t>(pos) >> 6) < readyCursor) readyCursor = static_cast<size_t>(pos) >> 6;
+                orderMark[w] = 0;
+                movedReady = true;
             }
         }
     }
-    // Helper to process a single node: execute, propagate, mark changes and enqueue dependents
-    auto processNode = [&](const NodeId& nodeId) {
-        auto it = std::find_if(nodes.begin(), nodes.end(), [&](const Node& n) { return n.id == nodeId; });
-        if (it == nodes.end()) return;
-        // Capture previous first-output value for change detection
-        Value prevOut0;
-        bool hasPrev0 = false;
-        if (!it->outputs.empty()) { prevOut0 = it->outputs[0].value; hasPrev0 = true; }
-        // Handle-based execution for common node types (Value, DeviceTrigger, Add)
-        bool handled = false;
-        if (it->type == "Value") {
-            Value v = 0.0f;
-            auto p = it->parameters.find("value");
-            if (p != it->parameters.end()) v = p->second;
-            for (auto &op : it->outputs) {
-                op.value = v;
-                int hOut = getPortHandle(it->id, op.id, "output");
-                if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                    this->portValues[hOut] = v;
-                    if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                    for (int hIn : outToIn[hOut]) {
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                            this->portValues[hIn] = v;
-                            (void)portDescs;
-                        }
-                    }
-                }
+    if (movedReady && scheduler == Scheduler::LegacyQueue) {
+        std::stable_sort(legacyQueue.begin(), legacyQueue.end(), [&](int a, int b){
+            return plan.topoIndex[a] < plan.topoIndex[b];
+        });
+    }
+    // executionOrder (codegen only) is refreshed by the next level relayout
+    plan.levelsDirty = true;
+}
+
+void FlowEngine::disconnect(const Connection& c) {
+    ++publishEpoch;
+    const auto hs = resolveConnection(c);
+    auto it = std::find_if(connections.begin(), connections.end(), [&](const Connection &cc){
+        return cc.fromNode == c.fromNode && cc.fromPort == c.fromPort && cc.toNode == c.toNode && cc.toPort == c.toPort;
+    });
+    if (it == connections.end()) {
+        throw std::runtime_error("Unknown connection: " + c.fromNode + ":" + c.fromPort + " -> " + c.toNode + ":" + c.toPort);
+    }
+    connections.erase(it);
+    unlinkEdge(hs.first, hs.second);
+    // An unwired input reads 0, as it would after a fresh load
+    if (plan.inputWires[hs.second] == 0) {
+        if (portSlot[hs.second].lane == DType::String) laneString[portSlot[hs.second].slot].clear();
+        else storeAs<double>(hs.second, 0.0);
+    }
+    plan.levelsDirty = true;
+    enqueueNode(plan.portNode[hs.second]);
+}
+
+void FlowEngine::removeNode(const std::string& nodeId) {
+    ++publishEpoch;
+    auto itIdx = nodeIndex.find(nodeId);
+    if (itIdx == nodeIndex.end()) throw std::runtime_error("Unknown node: " + nodeId);
+    const int ni = static_cast<int>(itIdx->second);
+    // Drop every wire touching the node; disconnect erases entry i itself
+    for (size_t i = 0; i < connections.size();) {
+        if (connections[i].fromNode == nodeId || connections[i].toNode == nodeId) {
+            const Connection c = connections[i];
+            disconnect(c);
+        } else {
+            ++i;
+        }
+    }
+    // Leave the ready set and the topo order (the position stays a hole until
+    // the next relayout)
+    const size_t pos = static_cast<size_t>(plan.topoIndex[ni]);
+    const unsigned long long bit = 1ull << (pos & 63);
+    if (readyBits[pos >> 6] & bit) {
+        readyBits[pos >> 6] &= ~bit;
+        --readyCount;
+        legacyQueue.erase(std::remove(legacyQueue.begin(), legacyQueue.end(), ni), legacyQueue.end());
+    }
+    plan.topoOrder[pos] = -1;
+    plan.topoIndex[ni] = -1;
+    plan.timerNodes.erase(std::remove(plan.timerNodes.begin(), plan.timerNodes.end(), ni), plan.timerNodes.end());
+    ++timerArm[ni]; // drops its pending heap entry
+    timerPulsing.erase(std::remove(timerPulsing.begin(), timerPulsing.end(), ni), timerPulsing.end());
+    executionOrder.erase(std::remove(executionOrder.begin(), executionOrder.end(), nodeId), executionOrder.end());
+    // Tombstone descriptors; handles are never reused
+    NodeDesc &nd = nodeDescs[ni];
+    for (const auto *ports : {&nd.inputPorts, &nd.outputPorts}) {
+        for (PortHandle h : *ports) {
+            portKeyToHandle.erase(nodeId + ":" + portDescs[h].portId + ":" + portDescs[h].direction);
+            portDescs[h].removed = true;
+        }
+    }
+    nd.removed = true;
+    nodeIndex.erase(itIdx);
+    ++removedNodes;
+    plan.levelsDirty = true;
+}
+
+nlohmann::json FlowEngine::toJson() const {
+    nlohmann::json j;
+    j["nodes"] = nlohmann::json::array();
+    for (size_t ni = 0; ni < nodes.size(); ++ni) {
+        if (nodeDescs[ni].removed) continue;
+        const Node &node = nodes[ni];
+        nlohmann::json nj;
+        nj["id"] = node.id;
+        nj["type"] = node.type;
+        nj["inputs"] = nlohmann::json::array();
+        nj["outputs"] = nlohmann::json::array();
+        for (const auto &p : node.inputs) nj["inputs"].push_back({{"id", p.id}, {"type", p.dataType}});
+        for (const auto &p : node.outputs) {
+            nlohmann::json pj = {{"id", p.id}, {"type", p.dataType}};
+            if (p.deadband > 0.0) pj["deadband"] = p.deadband;
+            nj["outputs"].push_back(pj);
+        }
+        nlohmann::json params = nlohmann::json::object();
+        for (const auto &kv : node.parameters) {
+            std::visit([&](const auto &v){ params[kv.first] = v; }, kv.second);
+        }
+        if (!params.empty()) nj["parameters"] = params;
+        j["nodes"].push_back(nj);
+    }
+    j["connections"] = nlohmann::json::array();
+    for (const auto &c : connections) {
+        j["connections"].push_back({{"fromNode", c.fromNode}, {"fromPort", c.fromPort}, {"toNode", c.toNode}, {"toPort", c.toPort}});
+    }
+    return j;
+}
+
+void FlowEngine::propagateOutput(PortHandle hOut) {
+    const unsigned int s = portSlot[hOut].slot;
+    for (int e = plan.outToIn.begin(hOut); e < plan.outToIn.end(hOut); ++e) {
+        const EdgeTarget &t = plan.outToIn.items[e];
+        const unsigned int d = t.slot;
+        switch (t.cast) {
+            case IntToInt:       laneInt[d] = laneInt[s]; break;
+            case IntToFloat:     laneFloat[d] = static_cast<float>(laneInt[s]); break;
+            case IntToDouble:    laneDouble[d] = static_cast<double>(laneInt[s]); break;
+            case FloatToInt:     laneInt[d] = static_cast<int>(laneFloat[s]); break;
+            case FloatToFloat:   laneFloat[d] = laneFloat[s]; break;
+            case FloatToDouble:  laneDouble[d] = static_cast<double>(laneFloat[s]); break;
+            case DoubleToInt:    laneInt[d] = static_cast<int>(laneDouble[s]); break;
+            case DoubleToFloat:  laneFloat[d] = static_cast<float>(laneDouble[s]); break;
+            case DoubleToDouble: laneDouble[d] = laneDouble[s]; break;
+            case StringToString: laneString[d] = laneString[s]; break;
+        }
+    }
+}
+
+// Evaluate node ni's kernel. Each output is compared with its previous value
+// and only changed ones are stamped and propagated; returns true if any
+// changed (callers then schedule the consumers of those ports). Only touches
+// ni's own outputs/state and the inputs its wires feed, so nodes of one level
+// may run concurrently.
+bool FlowEngine::evalNode(int ni) {
+    const Node &node = nodes[ni];
+    const NodePorts &np = plan.nodePorts[ni];
+    const PortHandle h0 = np.firstOutput;
+    const PortHandle inEnd = np.firstInput + np.numInputs;
+    const PortHandle outEnd = np.firstOutput + np.numOutputs;
+    bool changed = false;
+    switch (plan.kernel[ni]) {
+        case KernelValue:
+            // Missing "value" writes 0
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<double>(hOut, nodeParam[ni]);
+            break;
+        case KernelDeviceTrigger:
+            // Use last set value or keep current outputs
+            if (nodeParamSet[ni]) {
+                for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<double>(hOut, nodeParam[ni]);
             }
-            handled = true;
-        } else if (it->type == "DeviceTrigger") {
-            // Use last set value (parameters["value"]) or keep current outputs
-            Value vOut;
-            bool have = false;
-            auto p = it->parameters.find("value");
-            if (p != it->parameters.end()) { vOut = p->second; have = true; }
-            for (auto &op : it->outputs) {
-                if (have) op.value = vOut;
-                int hOut = getPortHandle(it->id, op.id, "output");
-                if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                    this->portValues[hOut] = op.value;
-                    if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                    for (int hIn : outToIn[hOut]) {
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                            this->portValues[hIn] = op.value;
-                            (void)portDescs;
-                        }
-                    }
-                }
+            break;
+        case KernelValueString:
+        case KernelDeviceTriggerString: {
+            // String side table; not on the numeric fast path
+            auto p = node.parameters.find("value");
+            if (p != node.parameters.end() && std::holds_alternative<std::string>(p->second)) {
+                const std::string &v = std::get<std::string>(p->second);
+                for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutputString(hOut, v);
             }
-            handled = true;
-        } else if (it->type == "Add") {
-            if (!it->outputs.empty()) {
-                const std::string &dtype = it->outputs[0].dataType;
-                auto baseType = [&](const std::string &t){ return t; };
-                std::string bt = baseType(dtype);
-                // Sum with compute dtype matching output dtype (cast inputs)
-                if (bt == "int") {
-                    long long sum = 0;
-                    for (const auto &ip : it->inputs) {
-                        int hIn = getPortHandle(it->id, ip.id, "input");
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                            const Value &vv = this->portValues[hIn];
-                            if (std::holds_alternative<int>(vv)) sum += std::get<int>(vv);
-                            else if (std::holds_alternative<float>(vv)) sum += (int)std::get<float>(vv);
-                            else if (std::holds_alternative<double>(vv)) sum += (int)std::get<double>(vv);
-                        }
-                    }
-                    for (auto &op : it->outputs) {
-                        op.value = (int)sum;
-                        int hOut = getPortHandle(it->id, op.id, "output");
-                        if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                            this->portValues[hOut] = (int)sum;
-                            if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                            for (int hIn : outToIn[hOut]) if (hIn >= 0 && (size_t)hIn < portValues.size()) this->portValues[hIn] = (int)sum;
-                        }
-                    }
-                } else if (bt == "double") {
-                    double sum = 0.0;
-                    for (const auto &ip : it->inputs) {
-                        int hIn = getPortHandle(it->id, ip.id, "input");
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                            const Value &vv = this->portValues[hIn];
-                            if (std::holds_alternative<double>(vv)) sum += std::get<double>(vv);
-                            else if (std::holds_alternative<float>(vv)) sum += (double)std::get<float>(vv);
-                            else if (std::holds_alternative<int>(vv)) sum += (double)std::get<int>(vv);
-                        }
-                    }
-                    for (auto &op : it->outputs) {
-                        op.value = (double)sum;
-                        int hOut = getPortHandle(it->id, op.id, "output");
-                        if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                            this->portValues[hOut] = sum;
-                            if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                            for (int hIn : outToIn[hOut]) if (hIn >= 0 && (size_t)hIn < portValues.size()) this->portValues[hIn] = sum;
-                        }
-                    }
-                } else { // float/default
-                    float sum = 0.0f;
-                    for (const auto &ip : it->inputs) {
-                        int hIn = getPortHandle(it->id, ip.id, "input");
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                            const Value &vv = this->portValues[hIn];
-                            if (std::holds_alternative<float>(vv)) sum += std::get<float>(vv);
-                            else if (std::holds_alternative<double>(vv)) sum += (float)std::get<double>(vv);
-                            else if (std::holds_alternative<int>(vv)) sum += (float)std::get<int>(vv);
-                        }
-                    }
-                    for (auto &op : it->outputs) {
-                        op.value = (float)sum;
-                        int hOut = getPortHandle(it->id, op.id, "output");
-                        if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                            this->portValues[hOut] = sum;
-                            if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                            for (int hIn : outToIn[hOut]) if (hIn >= 0 && (size_t)hIn < portValues.size()) this->portValues[hIn] = sum;
-                        }
-                    }
-                }
+            break;
+        }
+        // Add: sum with compute dtype matching output dtype (cast inputs)
+        case KernelAddInt: {
+            long long sum = 0;
+            for (PortHandle hIn = np.firstInput; hIn < inEnd; ++hIn) sum += loadAs<int>(hIn);
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<int>(hOut, static_cast<int>(sum));
+            break;
+        }
+        case KernelAddFloat: {
+            float sum = 0.0f;
+            for (PortHandle hIn = np.firstInput; hIn < inEnd; ++hIn) sum += loadAs<float>(hIn);
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<float>(hOut, sum);
+            break;
+        }
+        case KernelAddDouble: {
+            double sum = 0.0;
+            for (PortHandle hIn = np.firstInput; hIn < inEnd; ++hIn) sum += loadAs<double>(hIn);
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<double>(hOut, sum);
+            break;
+        }
+        case KernelAddString: {
+            std::string result;
+            for (PortHandle hIn = np.firstInput; hIn < inEnd; ++hIn) {
+                if (portSlot[hIn].lane == DType::String) result += laneString[portSlot[hIn].slot];
             }
-            handled = true;
-        } else if (it->type == "Counter") {
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutputString(hOut, result);
+            break;
+        }
+        case KernelCounter: {
             // Rising-edge counter: increments when input goes 0->1
-            size_t idx = nodeIndex.count(it->id) ? nodeIndex[it->id] : (size_t)-1;
             int tickNow = 0;
-            if (!it->inputs.empty()) {
-                int hIn = getPortHandle(it->id, it->inputs[0].id, "input");
-                if (hIn >= 0 && (size_t)hIn < portValues.size()) {
-                    const Value &vv = this->portValues[hIn];
-                    double dv = 0.0;
-                    if (std::holds_alternative<double>(vv)) dv = std::get<double>(vv);
-                    else if (std::holds_alternative<float>(vv)) dv = (double)std::get<float>(vv);
-                    else if (std::holds_alternative<int>(vv)) dv = (double)std::get<int>(vv);
-                    tickNow = (dv > 0.5) ? 1 : 0;
-                }
-            }
-            if (idx != (size_t)-1) {
-                if (tickNow == 1 && counterLastTick[idx] == 0) {
-                    counterValue[idx] += 1.0;
-                }
-                counterLastTick[idx] = tickNow;
-                // Write output with current count
-                for (auto &op : it->outputs) {
-                    const std::string &dtype = op.dataType;
-                    auto baseType = [&](const std::string &t){ return t; };
-                    std::string bt = baseType(dtype);
-                    if (bt == "int") op.value = (int)counterValue[idx];
-                    else if (bt == "double") op.value = (double)counterValue[idx];
-                    else op.value = (float)counterValue[idx];
-                    int hOut = getPortHandle(it->id, op.id, "output");
-                    if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                        if (bt == "int") this->portValues[hOut] = (int)counterValue[idx];
-                        else if (bt == "double") this->portValues[hOut] = (double)counterValue[idx];
-                        else this->portValues[hOut] = (float)counterValue[idx];
-                        if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-                        for (int hIn : outToIn[hOut]) {
-                            if (hIn >= 0 && (size_t)hIn < portValues.size()) this->portValues[hIn] = this->portValues[hOut];
-                        }
-                    }
-                }
-            }
-            handled = true;
-        } else {
-            // Unknown node type: leave outputs unchanged (no-op)
-        }
-        // Mark node changed if primary output changed compared to previous
-        bool changedPrimary = false;
-        if (!it->outputs.empty() && hasPrev0) {
-            const auto &new0 = it->outputs[0].value;
-            bool changed = prevOut0.index() != new0.index();
-            if (!changed) {
-                if (std::holds_alternative<float>(new0)) changed = std::get<float>(prevOut0) != std::get<float>(new0);
-                else if (std::holds_alternative<double>(new0)) changed = std::get<double>(prevOut0) != std::get<double>(new0);
-                else if (std::holds_alternative<int>(new0)) changed = std::get<int>(prevOut0) != std::get<int>(new0);
-                else if (std::holds_alternative<std::string>(new0)) changed = std::get<std::string>(prevOut0) != std::get<std::string>(new0);
+            if (np.numInputs > 0) tickNow = (loadAs<double>(np.firstInput) > 0.5) ? 1 : 0;
+            if (tickNow == 1 && counterLastTick[ni] == 0) {
+                counterValue[ni] += 1.0;
             }
-            if (changed) { outputChangedStamp[it->id] = evalGeneration; changedPrimary = true; }
+            counterLastTick[ni] = tickNow;
+            // Write output with current count (cast to each output's dtype)
+            for (PortHandle hOut = h0; hOut < outEnd; ++hOut) changed |= storeOutput<double>(hOut, counterValue[ni]);
+            break;
         }
-        // Enqueue dependents only when outputs changed
-        if (changedPrimary) enqueueDependents(it->id);
-    };
+        case KernelTimer:
+            // Outputs are driven by tick(); nothing to evaluate here
+            break;
+    }
+    if (coldStart && plan.kernel[ni] != KernelTimer) {
+        // First pass: every output counts as fresh for deltas (lanes were
+        // already propagated at the start of execute)
+        for (PortHandle hOut = h0; hOut < outEnd; ++hOut) markChanged(hOut, evalGeneration);
+    }
+    return changed;
+}
+
+// Evaluate the graph once (non-blocking). Performs handle-based propagation
+// and executes nodes in topological order.
+void FlowEngine::execute() {
+    auto t0 = std::chrono::steady_clock::now();
+    // bump evaluation generation; inputs drained now are stamped with it
+    ++evalGeneration;
+    const size_t applied = drainInputs();
 
-    // Deterministic scheduling: first time run full topo, then ready-queue
+    // Only on cold start do we perform initial propagation (lanes start zeroed); subsequent ticks are dirty-driven
     if (coldStart) {
-        for (const auto& nodeId : executionOrder) { processNode(nodeId); ++perf.nodesEvaluated; }
-        readyQueue.clear();
-        coldStart = false;
+        for (PortHandle h = 0; h < static_cast<PortHandle>(portSlot.size()); ++h) propagateOutput(h);
+    }
+
+    if (pool && plan.multiFedInputs == 0) {
+        // Edits append nodes out of level order; relayout before a level pass
+        if (plan.levelsDirty) orderNodes();
+        deferChangeLog = true;
+        if (coldStart || parallelMode == ParallelMode::Levels) {
+            executeLevels();
+        } else {
+            executeStealing();
+            for (int ni : waveNodes) logNodeChanges(ni);
+        }
+        deferChangeLog = false;
+    } else if (coldStart) {
+        // Deterministic scheduling: first time run full topo, then ready-queue
+        for (int ni : plan.topoOrder) {
+            if (ni < 0) continue; // removed node
+            evalNode(ni);
+            ++perf.nodesEvaluated;
+        }
+        clearReady();
     } else {
-        while (!readyQueue.empty()) {
-            auto nodeId = readyQueue.front();
-            readyQueue.erase(readyQueue.begin());
-            processNode(nodeId);
+        for (int ni = popReady(); ni >= 0; ni = popReady()) {
+            // Enqueue only the consumers of outputs that changed
+            if (evalNode(ni)) enqueueChangedConsumers(ni);
             ++perf.nodesEvaluated;
-            if (readyQueue.size() > perf.readyQueueMax) perf.readyQueueMax = readyQueue.size();
         }
     }
+    coldStart = false;
+    if (publishEnabled) publishSnapshot();
     auto t1 = std::chrono::steady_clock::now();
+    if (applied > 0) {
+        const auto nowNs = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1.time_since_epoch()).count());
+        for (PortHandle h : inputTouched) ++perf.inputLatencyHist[PerfStats::latencyBucket(nowNs - inputStampNs[h])];
+    }
     auto ns = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
     ++perf.evalCount;
     perf.evalTimeNsAccum += ns;
@@ -554,95 +1254,297 @@ void FlowEngine::execute() {
     if (ns > perf.evalTimeNsMax) perf.evalTimeNsMax = ns;
 }
 
-// Advance time-based nodes; emit pulses and enqueue dependents
-void FlowEngine::tick(double dtMs) {
-    if (dtMs <= 0.0) return;
-    // For each Timer node, accumulate and emit a one-tick pulse when interval reached
-    for (size_t i = 0; i < nodes.size(); ++i) {
-        auto &n = nodes[i];
-        if (n.type != "Timer" || n.outputs.empty()) continue;
-        double interval = 0.0;
-        auto itp = n.parameters.find("interval_ms");
-        if (itp != n.parameters.end()) {
-            if (std::holds_alternative<int>(itp->second)) interval = (double)std::get<int>(itp->second);
-            else if (std::holds_alternative<float>(itp->second)) interval = (double)std::get<float>(itp->second);
-            else if (std::holds_alternative<double>(itp->second)) interval = std::get<double>(itp->second);
+// Level-synchronous pass: each level's ready nodes run across the pool, with
+// the pool's join acting as the barrier. Dependents are enqueued by the calling
+// thread after the barrier in topo order, so the set of evaluated nodes and
+// every written value match the serial path.
+void FlowEngine::executeLevels() {
+    const size_t numLevels = plan.levelOffsets.empty() ? 0 : plan.levelOffsets.size() - 1;
+    for (size_t L = 0; L < numLevels; ++L) {
+        const int begin = plan.levelOffsets[L];
+        const int end = plan.levelOffsets[L + 1];
+        levelBatch.clear();
+        if (coldStart) {
+            for (int pos = begin; pos < end; ++pos) levelBatch.push_back(plan.topoOrder[pos]);
+        } else {
+            takeReadyRange(begin, end);
         }
-        if (interval <= 0.0) continue;
-        timerAccumMs[i] += dtMs;
-        if (timerAccumMs[i] >= interval) {
-            timerAccumMs[i] -= interval;
-            // Emit pulse 1.0 for this eval
-            int hOut = getPortHandle(n.id, n.outputs[0].id, "output");
-            if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                // Write pulse in declared output dtype
-                const std::string &dtype = n.outputs[0].dataType;
-                auto baseType = [&](const std::string &t){ return t; };
-                std::string bt = baseType(dtype);
-                if (bt == "int") { portValues[hOut] = (int)1; n.outputs[0].value = (int)1; }
-                else if (bt == "double") { portValues[hOut] = (double)1.0; n.outputs[0].value = (double)1.0; }
-                else { portValues[hOut] = (float)1.0f; n.outputs[0].value = (float)1.0f; }
-                if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration + 1;
-                for (int hIn : outToIn[hOut]) {
-                    if (hIn >= 0 && (size_t)hIn < portValues.size()) portValues[hIn] = 1.0f;
-                }
+        if (levelBatch.empty()) continue;
+        auto tl0 = std::chrono::steady_clock::now();
+        levelChanged.assign(levelBatch.size(), 0);
+        pool->parallelFor(levelBatch.size(), [this](size_t i) {
+            levelChanged[i] = evalNode(levelBatch[i]) ? 1 : 0;
+        });
+        for (size_t i = 0; i < levelBatch.size(); ++i) if (levelChanged[i] || coldStart) logNodeChanges(levelBatch[i]);
+        if (!coldStart) {
+            for (size_t i = 0; i < levelBatch.size(); ++i) if (levelChanged[i]) enqueueChangedConsumers(levelBatch[i]);
+        }
+        auto tl1 = std::chrono::steady_clock::now();
+        const size_t slot = (L < PerfStats::kMaxLevels) ? L : PerfStats::kMaxLevels - 1;
+        perf.levelTimeNsAccum[slot] += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(tl1 - tl0).count();
+        perf.levelNodes[slot] += levelBatch.size();
+        if (slot + 1 > perf.levelsUsed) perf.levelsUsed = slot + 1;
+        perf.nodesEvaluated += levelBatch.size();
+    }
+    clearReady();
+}
+
+// Pop every ready bit in topo positions [begin, end) into levelBatch
+void FlowEngine::takeReadyRange(int begin, int end) {
+    for (int pos = begin; pos < end && readyCount > 0;) {
+        const size_t w = static_cast<size_t>(pos) >> 6;
+        unsigned long long word = readyBits[w] & (~0ull << (pos & 63));
+        const int wordEnd = static_cast<int>((w + 1) << 6);
+        if (end < wordEnd) word &= (1ull << (end & 63)) - 1;
+        for (; word; word &= word - 1) {
+            const size_t p = (w << 6) + lowestSetBit(word);
+            readyBits[w] &= ~(1ull << (p & 63));
+            --readyCount;
+            levelBatch.push_back(plan.topoOrder[p]);
+        }
+        pos = wordEnd;
+    }
+}
+
+// Work-stealing wave: mark the closure of the ready nodes (counting in-wave
+// predecessors), then let the workers drain it. A node runs once its pending
+// count reaches zero, i.e. after every in-wave predecessor has finished and
+// written its inputs, and is evaluated only if one of them changed, exactly
+// the serial rule. Pure nodes therefore see the same inputs and produce the
+// same values as the serial order; only the interleaving differs.
+void FlowEngine::executeStealing() {
+    const Generation gen = evalGeneration;
+    waveNodes.clear();
+    for (size_t w = 0; w < readyBits.size(); ++w) {
+        for (unsigned long long b = readyBits[w]; b; b &= b - 1) {
+            const int ni = plan.topoOrder[(w << 6) + lowestSetBit(b)];
+            waveMark[ni] = gen;
+            wavePending[ni].store(0, std::memory_order_relaxed);
+            waveDirty[ni].store(1, std::memory_order_relaxed);
+            waveNodes.push_back(ni);
+        }
+    }
+    clearReady();
+    const size_t seeds = waveNodes.size();
+    for (size_t i = 0; i < waveNodes.size(); ++i) {
+        const int u = waveNodes[i];
+        for (int e = plan.dependents.begin(u); e < plan.dependents.end(u); ++e) {
+            const int v = plan.dependents.items[e].node;
+            if (waveMark[v] != gen) {
+                waveMark[v] = gen;
+                wavePending[v].store(0, std::memory_order_relaxed);
+                waveDirty[v].store(0, std::memory_order_relaxed);
+                waveNodes.push_back(v);
             }
-            outputChangedStamp[n.id] = evalGeneration + 1;
-            enqueueDependents(n.id);
-        } else {
-            // Hold at 0.0 between pulses; if transitioning 1->0, propagate and enqueue
-            int hOut = getPortHandle(n.id, n.outputs[0].id, "output");
-            if (hOut >= 0 && (size_t)hOut < portValues.size()) {
-                double prev = 0.0;
-                const Value &pv = portValues[hOut];
-                if (std::holds_alternative<double>(pv)) prev = std::get<double>(pv);
-                else if (std::holds_alternative<float>(pv)) prev = (double)std::get<float>(pv);
-                else if (std::holds_alternative<int>(pv)) prev = (double)std::get<int>(pv);
-                // Reset to 0 in declared dtype
-                const std::string &dtype = n.outputs[0].dataType;
-                auto baseType = [&](const std::string &t){ return t; };
-                std::string bt = baseType(dtype);
-                if (bt == "int") { portValues[hOut] = (int)0; n.outputs[0].value = (int)0; }
-                else if (bt == "double") { portValues[hOut] = (double)0.0; n.outputs[0].value = (double)0.0; }
-                else { portValues[hOut] = (float)0.0f; n.outputs[0].value = (float)0.0f; }
-                if (prev > 0.5) {
-                    if ((size_t)hOut < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration + 1;
-                    for (int hIn : outToIn[hOut]) {
-                        if (hIn >= 0 && (size_t)hIn < portValues.size()) portValues[hIn] = 0.0f;
-                    }
-                    enqueueDependents(n.id);
+            wavePending[v].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (waveNodes.size() > perf.readyQueueMax) perf.readyQueueMax = waveNodes.size();
+
+    // Finish node u: flag the consumers of its changed ports and release
+    // dependents with no pending inputs
+    auto complete = [this, gen](int u, bool changed, const std::function<void(int)> &ready) {
+        if (changed) {
+            const NodePorts &np = plan.nodePorts[u];
+            for (PortHandle h = np.firstOutput; h < np.firstOutput + np.numOutputs; ++h) {
+                if (portChangedStamp[h] != gen) continue;
+                for (int e = plan.outToIn.begin(h); e < plan.outToIn.end(h); ++e) {
+                    waveDirty[plan.portNode[plan.outToIn.items[e].input]].store(1, std::memory_order_relaxed);
                 }
             }
         }
+        for (int e = plan.dependents.begin(u); e < plan.dependents.end(u); ++e) {
+            const int v = plan.dependents.items[e].node;
+            if (wavePending[v].fetch_sub(1, std::memory_order_acq_rel) == 1) ready(v);
+        }
+    };
+
+    // Small waves are not worth waking the pool: walk them in topo order
+    if (waveNodes.size() < kMinStealWave) {
+        std::sort(waveNodes.begin(), waveNodes.end(), [&](int a, int b){ return plan.topoIndex[a] < plan.topoIndex[b]; });
+        const std::function<void(int)> none = [](int){};
+        for (int ni : waveNodes) {
+            bool changed = false;
+            if (waveDirty[ni].load(std::memory_order_relaxed)) { changed = evalNode(ni); ++perf.nodesEvaluated; }
+            complete(ni, changed, none);
+        }
+        return;
     }
-}
 
-void FlowEngine::enqueueNode(const NodeId& id) {
-    // Dedup by generation and stable order by topo index
-    if (readyStamp[id] == evalGeneration) return;
-    readyStamp[id] = evalGeneration;
-    readyQueue.push_back(id);
-    std::stable_sort(readyQueue.begin(), readyQueue.end(), [&](const NodeId& a, const NodeId& b){
-        int ia = topoIndex.count(a) ? topoIndex[a] : 0;
-        int ib = topoIndex.count(b) ? topoIndex[b] : 0;
-        if (ia != ib) return ia < ib;
-        return a < b;
+    // Seed the deques round-robin with the nodes that have no pending inputs
+    const int nw = pool->size();
+    for (size_t i = 0, k = 0; i < seeds; ++i) {
+        if (wavePending[waveNodes[i]].load(std::memory_order_relaxed) == 0) stealDeques[k++ % nw]->push(waveNodes[i]);
+    }
+    std::atomic<size_t> remaining{waveNodes.size()};
+    std::fill(workerEvaluated.begin(), workerEvaluated.end(), 0ull);
+    std::fill(workerStolen.begin(), workerStolen.end(), 0ull);
+    pool->runAll([&](int w) {
+        StealDeque &own = *stealDeques[w];
+        const std::function<void(int)> pushOwn = [&own](int v){ own.push(v); };
+        unsigned long long evaluated = 0, stolen = 0;
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            int ni = own.pop();
+            for (int k = 1; ni < 0 && k < nw; ++k) {
+                ni = stealDeques[(w + k) % nw]->steal();
+                if (ni >= 0) ++stolen;
+            }
+            if (ni < 0) { std::this_thread::yield(); continue; }
+            bool changed = false;
+            if (waveDirty[ni].load(std::memory_order_relaxed)) { changed = evalNode(ni); ++evaluated; }
+            complete(ni, changed, pushOwn);
+            remaining.fetch_sub(1, std::memory_order_release);
+        }
+        workerEvaluated[w] = evaluated;
+        workerStolen[w] = stolen;
     });
+    for (int w = 0; w < nw; ++w) {
+        perf.nodesEvaluated += workerEvaluated[w];
+        perf.tasksStolen += workerStolen[w];
+    }
+}
+
+void FlowEngine::setWorkers(int workers) {
+    if (workers <= 1) { pool.reset(); stealDeques.clear(); return; }
+    if (pool && pool->size() == workers) return;
+    pool.reset(new WorkerPool(workers));
+    stealDeques.clear();
+    for (int w = 0; w < workers; ++w) stealDeques.emplace_back(new StealDeque());
+    workerEvaluated.assign(workers, 0);
+    workerStolen.assign(workers, 0);
+}
+
+int FlowEngine::getWorkers() const { return pool ? pool->size() : 1; }
+
+// Advance time-based nodes; emit pulses and enqueue dependents
+void FlowEngine::tick(double dtMs) {
+    if (dtMs <= 0.0) return;
+    timerClockMs += dtMs;
+    // Fire every Timer now due: pulse 1 for this eval, written in declared
+    // output dtype. Re-arm after the loop so a timer fires once per tick.
+    timerFired.clear();
+    while (!timerHeap.empty() && timerHeap.front().dueMs <= timerClockMs) {
+        const TimerDue due = timerHeap.front();
+        std::pop_heap(timerHeap.begin(), timerHeap.end(), std::greater<TimerDue>());
+        timerHeap.pop_back();
+        const int i = due.node;
+        if (due.arm != timerArm[i]) continue; // removed or re-armed
+        timerBaseMs[i] += timerIntervalMs[i];
+        const PortHandle hOut = plan.nodePorts[i].firstOutput;
+        storeAs<double>(hOut, 1.0);
+        markChanged(hOut, evalGeneration + 1);
+        propagateOutput(hOut);
+        enqueueConsumers(hOut);
+        timerFired.push_back(i);
+    }
+    // Pulses from the previous tick drop back to 0 unless they fired again
+    for (int i : timerPulsing) {
+        if (std::find(timerFired.begin(), timerFired.end(), i) != timerFired.end()) continue;
+        const PortHandle hOut = plan.nodePorts[i].firstOutput;
+        const double prev = loadAs<double>(hOut);
+        storeAs<double>(hOut, 0.0);
+        if (prev > 0.5) {
+            markChanged(hOut, evalGeneration + 1);
+            propagateOutput(hOut);
+            enqueueConsumers(hOut);
+        }
+    }
+    timerPulsing.swap(timerFired);
+    for (int i : timerPulsing) {
+        timerHeap.push_back({timerBaseMs[i] + timerIntervalMs[i], i, timerArm[i]});
+        std::push_heap(timerHeap.begin(), timerHeap.end(), std::greater<TimerDue>());
+    }
+}
+
+// (Re)schedule Timer ni from its last fire with its current interval;
+// non-positive intervals never fire. Only called when the interval is set
+// (load, addNode); input sets on a Timer leave its schedule alone.
+void FlowEngine::armTimer(int ni) {
+    const unsigned int arm = ++timerArm[ni];
+    const double interval = timerIntervalMs[ni];
+    if (interval <= 0.0) return;
+    timerHeap.push_back({timerBaseMs[ni] + interval, ni, arm});
+    std::push_heap(timerHeap.begin(), timerHeap.end(), std::greater<TimerDue>());
+}
+
+void FlowEngine::enqueueNode(int node) {
+    // Dedup by membership bit; a node is re-enqueueable as soon as it is popped
+    const size_t pos = static_cast<size_t>(plan.topoIndex[node]);
+    const size_t w = pos >> 6;
+    const unsigned long long bit = 1ull << (pos & 63);
+    if (readyBits[w] & bit) return;
+    readyBits[w] |= bit;
+    if (w < readyCursor) readyCursor = w;
+    ++readyCount;
+    if (scheduler == Scheduler::LegacyQueue) {
+        legacyQueue.push_back(node);
+        std::stable_sort(legacyQueue.begin(), legacyQueue.end(), [&](int a, int b){
+            return plan.topoIndex[a] < plan.topoIndex[b];
+        });
+    }
+    if (readyCount > perf.readyQueueMax) perf.readyQueueMax = readyCount;
     ++perf.dependentsEnqueued;
 }
 
-void FlowEngine::enqueueDependents(const NodeId& id) {
-    auto it = dependents.find(id);
-    if (it == dependents.end()) return;
-    for (const auto &dn : it->second) enqueueNode(dn);
+int FlowEngine::popReady() {
+    if (readyCount == 0) return -1;
+    size_t pos;
+    if (scheduler == Scheduler::LegacyQueue) {
+        const int ni = legacyQueue.front();
+        legacyQueue.erase(legacyQueue.begin());
+        pos = static_cast<size_t>(plan.topoIndex[ni]);
+    } else {
+        // Dependents always sit at a higher topo position than the node being
+        // processed, so the cursor only moves forward within a wave
+        while (readyBits[readyCursor] == 0) ++readyCursor;
+        pos = (readyCursor << 6) + lowestSetBit(readyBits[readyCursor]);
+    }
+    readyBits[pos >> 6] &= ~(1ull << (pos & 63));
+    --readyCount;
+    return plan.topoOrder[pos];
+}
+
+void FlowEngine::clearReady() {
+    std::fill(readyBits.begin(), readyBits.end(), 0ull);
+    legacyQueue.clear();
+    readyCursor = readyBits.size();
+    readyCount = 0;
+}
+
+void FlowEngine::setScheduler(Scheduler s) {
+    if (s == scheduler) return;
+    // Rebuild the legacy vector from pending bits so no enqueued node is lost
+    legacyQueue.clear();
+    if (s == Scheduler::LegacyQueue) {
+        for (size_t w = 0; w < readyBits.size(); ++w) {
+            for (unsigned long long b = readyBits[w]; b; b &= b - 1) {
+                legacyQueue.push_back(plan.topoOrder[(w << 6) + lowestSetBit(b)]);
+            }
+        }
+    }
+    scheduler = s;
+}
+
+// Schedule every node with an input wired to output hOut
+void FlowEngine::enqueueConsumers(PortHandle hOut) {
+    for (int e = plan.outToIn.begin(hOut); e < plan.outToIn.end(hOut); ++e) enqueueNode(plan.portNode[plan.outToIn.items[e].input]);
+}
+
+// Schedule consumers of node ni's outputs stamped in the current eval
+void FlowEngine::enqueueChangedConsumers(int ni) {
+    const NodePorts &np = plan.nodePorts[ni];
+    for (PortHandle h = np.firstOutput; h < np.firstOutput + np.numOutputs; ++h) {
+        if (portChangedStamp[h] == evalGeneration) enqueueConsumers(h);
+    }
 }
 
 std::unordered_map<NodeId, std::vector<Value>> FlowEngine::getOutputs() const {
     std::unordered_map<NodeId, std::vector<Value>> outputs;
-    for (const auto& node : nodes) {
-        for (const auto& output : node.outputs) {
-            outputs[node.id].push_back(output.value);
-        }
+    for (size_t ni = 0; ni < nodes.size(); ++ni) {
+        if (nodeDescs[ni].removed) continue;
+        const NodePorts &np = plan.nodePorts[ni];
+        auto &vals = outputs[nodes[ni].id];
+        for (PortHandle h = np.firstOutput; h < np.firstOutput + np.numOutputs; ++h) vals.push_back(readPort(h));
     }
     return outputs;
 }
@@ -653,40 +1555,135 @@ Generation FlowEngine::beginSnapshot() {
 
 std::unordered_map<NodeId, Value> FlowEngine::getOutputsChangedSince(Generation lastSnapshotGen) const {
     std::unordered_map<NodeId, Value> out;
-    for (const auto& n : nodes) {
-        if (n.outputs.empty()) continue;
-        auto it = outputChangedStamp.find(n.id);
-        if (it != outputChangedStamp.end() && it->second > lastSnapshotGen) {
-            out.emplace(n.id, n.outputs[0].value);
-        }
-    }
+    forEachPortChangedSince(lastSnapshotGen, [&](PortHandle h) {
+        const int ni = plan.portNode[h];
+        if (h == plan.nodePorts[ni].firstOutput) out.emplace(nodes[ni].id, readPort(h));
+    });
     return out;
 }
 
 std::vector<std::tuple<NodeId, PortId, Value>> FlowEngine::getPortDeltasChangedSince(Generation lastSnapshotGen) const {
     std::vector<std::tuple<NodeId, PortId, Value>> deltas;
-    for (const auto &pd : portDescs) {
-        if (pd.direction != "output") continue;
-        if (static_cast<size_t>(pd.handle) >= portChangedStamp.size()) continue;
-        if (portChangedStamp[pd.handle] > lastSnapshotGen) {
-            // find node and port current value
-            for (const auto &n : nodes) {
-                if (n.id == pd.nodeId) {
-                    for (const auto &op : n.outputs) {
-                        if (op.id == pd.portId) {
-                            deltas.emplace_back(pd.nodeId, pd.portId, op.value);
-                            break;
-                        }
-                    }
-                    break;
-                }
-            }
+    forEachPortChangedSince(lastSnapshotGen, [&](PortHandle h) {
+        const PortDesc &pd = portDescs[h];
+        deltas.emplace_back(pd.nodeId, pd.portId, readPort(h));
+    });
+    return deltas;
+}
+
+void FlowEngine::logChange(PortHandle h) {
+    const Generation gen = portChangedStamp[h];
+    if (portLoggedStamp[h] == gen) return;
+    portLoggedStamp[h] = gen;
+    const Generation seq = changeLog.empty() ? gen : std::max(changeLog.back().seq, gen);
+    changeLog.push_back({h, gen, seq});
+    // Superseded entries are never visited; drop them once they outnumber
+    // the ports, keeping the order (and so the seq sort)
+    if (changeLog.size() > 2 * portLoggedStamp.size() + 64) {
+        size_t keep = 0;
+        for (const ChangeEntry &c : changeLog) {
+            if (c.handle < static_cast<PortHandle>(portLoggedStamp.size()) && c.gen == portLoggedStamp[c.handle]) changeLog[keep++] = c;
         }
+        changeLog.resize(keep);
     }
-    return deltas;
 }
 
-void FlowEngine::compileToExecutable(const std::string& outputFile, bool /*dslMode*/) {
+// Log the outputs of node ni stamped during a parallel pass
+void FlowEngine::logNodeChanges(int ni) {
+    const NodePorts &np = plan.nodePorts[ni];
+    for (PortHandle h = np.firstOutput; h < np.firstOutput + np.numOutputs; ++h) logChange(h);
+}
+
+size_t FlowEngine::firstChangeAfter(Generation since) const {
+    auto it = std::partition_point(changeLog.begin(), changeLog.end(), [since](const ChangeEntry &c) { return c.seq <= since; });
+    return static_cast<size_t>(it - changeLog.begin());
+}
+
+Value FlowEngine::PortSnapshot::read(PortHandle h) const {
+    if (h < 0 || static_cast<size_t>(h) >= lane.size()) return Value{};
+    switch (lane[h]) {
+        case DType::Int:    return static_cast<int>(number[h]);
+        case DType::Float:  return static_cast<float>(number[h]);
+        case DType::Double: return number[h];
+        case DType::String: return text[h];
+    }
+    return Value{};
+}
+
+void FlowEngine::snapshotPort(PortSnapshot& s, PortHandle h) const {
+    const PortSlot ps = portSlot[h];
+    switch (ps.lane) {
+        case DType::Int:    s.number[h] = laneInt[ps.slot]; break;
+        case DType::Float:  s.number[h] = laneFloat[ps.slot]; break;
+        case DType::Double: s.number[h] = laneDouble[ps.slot]; break;
+        case DType::String: s.text[h] = laneString[ps.slot]; break;
+    }
+}
+
+void FlowEngine::publishSnapshot() {
+    // A buffer only the pool references is invisible to readers (the published
+    // one is also held by `published`), so it can be overwritten in place
+    SnapshotBuffer *buf = nullptr;
+    for (auto &b : snapshotPool) {
+        if (!b.snap || b.snap.use_count() == 1) { buf = &b; break; }
+    }
+    // use_count() is a relaxed load; pair it with the readers' releasing
+    // decrement so their last reads happen before our writes
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!buf) {
+        // Every buffer is pinned by a reader: hand the oldest over to them
+        buf = &snapshotPool[0];
+        for (auto &b : snapshotPool) if (b.snap->generation < buf->snap->generation) buf = &b;
+        buf->snap.reset();
+        buf->epoch = 0;
+    }
+    if (!buf->snap) buf->snap = std::make_shared<PortSnapshot>();
+    PortSnapshot &s = *buf->snap;
+    const size_t n = portSlot.size();
+    if (buf->epoch != publishEpoch) {
+        if (descsEpoch != publishEpoch) {
+            publishedDescs = std::make_shared<const std::vector<PortDesc>>(portDescs);
+            descsEpoch = publishEpoch;
+        }
+        s.descs = publishedDescs;
+        s.lane.resize(n);
+        s.number.assign(n, 0.0);
+        s.text.assign(n, std::string());
+        for (size_t h = 0; h < n; ++h) {
+            s.lane[h] = portSlot[h].lane;
+            snapshotPort(s, static_cast<PortHandle>(h));
+        }
+        s.changed = portChangedStamp;
+        buf->epoch = publishEpoch;
+    } else {
+        // Same layout: copy ports stamped since this buffer was last filled,
+        // plus the inputs their wires feed. Stamps equal to the buffer's
+        // generation are included: setNodeValue between evals stamps the
+        // current generation after it may already have been published.
+        forEachPortChangedSince(s.generation - 1, [&](PortHandle h) {
+            snapshotPort(s, h);
+            s.changed[h] = portChangedStamp[h];
+            for (int e = plan.outToIn.begin(h); e < plan.outToIn.end(h); ++e) {
+                snapshotPort(s, plan.outToIn.items[e].input);
+            }
+        });
+    }
+    s.generation = evalGeneration;
+    std::atomic_store(&published, std::shared_ptr<const PortSnapshot>(buf->snap));
+}
+
+std::shared_ptr<const FlowEngine::PortSnapshot> FlowEngine::getSnapshot() const {
+    return std::atomic_load(&published);
+}
+
+void FlowEngine::compileToExecutable(const std::string& outputFile, bool dslMode) {
+    // Codegen walks nodes/connections directly; emit edited graphs from a clean reload
+    if (removedNodes > 0 || plan.levelsDirty) {
+        FlowEngine live;
+        live.loadFromJson(toJson());
+        live.compileToExecutable(outputFile, dslMode);
+        return;
+    }
     // Minimal C++ codegen: emit a small standalone program computing the Add flow
     // from the current in-memory graph (assumes three inputs to 'add1').
     std::string sourcePath = outputFile + ".cpp";
@@ -768,6 +1765,12 @@ void FlowEngine::compileToExecutable(const std::string& outputFile, bool /*dslMo
 } // namespace NodeFlow
  
 void NodeFlow::FlowEngine::generateStepLibraryLLVM(const std::string& baseName) const {
+    if (removedNodes > 0 || plan.levelsDirty) {
+        FlowEngine live;
+        live.loadFromJson(toJson());
+        live.generateStepLibraryLLVM(baseName);
+        return;
+    }
     const std::string headerPath = baseName + "_step.h";
     const std::string descPath = baseName + "_step_desc.cpp"; // descriptors and glue
     const std::string irPath = baseName + "_step.ll";          // LLVM IR for step/step_n
@@ -975,53 +1978,180 @@ void NodeFlow::FlowEngine::generateStepLibraryLLVM(const std::string& baseName)
 }
 
 void NodeFlow::FlowEngine::setNodeValue(const std::string& nodeId, float value) {
-    auto it = std::find_if(nodes.begin(), nodes.end(), [&](const Node& n){ return n.id == nodeId; });
-    if (it == nodes.end()) return;
-    float prev = 0.0f;
-    if (!it->outputs.empty()) {
-        const auto &v = it->outputs[0].value;
-        if (std::holds_alternative<float>(v)) prev = std::get<float>(v);
-        else if (std::holds_alternative<double>(v)) prev = static_cast<float>(std::get<double>(v));
-        else if (std::holds_alternative<int>(v)) prev = static_cast<float>(std::get<int>(v));
-    }
-    it->parameters["value"] = static_cast<float>(value);
-    bool changed = (prev != value);
-    for (auto &out : it->outputs) out.value = static_cast<float>(value);
-    // Update SoA values immediately for this node's outputs and propagate to downstream inputs
-    for (const auto &op : it->outputs) {
-        int hOut = getPortHandle(it->id, op.id, "output");
-        if (hOut >= 0 && static_cast<size_t>(hOut) < portValues.size()) {
-            portValues[hOut] = static_cast<float>(value);
-            if (static_cast<size_t>(hOut) < portChangedStamp.size()) portChangedStamp[hOut] = evalGeneration;
-            for (int hIn : outToIn[hOut]) {
-                if (hIn >= 0 && static_cast<size_t>(hIn) < portValues.size()) {
-                    portValues[hIn] = static_cast<float>(value);
-                }
-            }
+    auto itIdx = nodeIndex.find(nodeId);
+    if (itIdx == nodeIndex.end()) return;
+    setNodeValueAt(static_cast<int>(itIdx->second), value);
+}
+
+size_t NodeFlow::FlowEngine::setNodeValues(const InputValue* values, size_t count) {
+    // Inputs queued before this batch must not land on top of it
+    drainInputs();
+    if (inputMark.size() < portDescs.size()) {
+        inputMark.resize(portDescs.size(), 0);
+        inputLatest.resize(portDescs.size(), 0.0f);
+        inputStampNs.resize(portDescs.size(), 0);
+    }
+    // Same per-round dedup as drainInputs (both run under the engine lock)
+    const Generation round = ++inputRound;
+    inputTouched.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const PortHandle h = values[i].handle;
+        if (h < 0 || static_cast<size_t>(h) >= portDescs.size() || portDescs[h].removed) continue;
+        if (inputMark[h] != round) {
+            inputMark[h] = round;
+            inputTouched.push_back(h);
         }
+        inputLatest[h] = values[i].value;
     }
-    if (changed) {
-        // mark node output changed this eval generation
-        outputChangedStamp[it->id] = evalGeneration;
-        // and the port handle
-        for (const auto &op : it->outputs) {
-            int ph = getPortHandle(it->id, op.id, "output");
-            if (ph >= 0 && static_cast<size_t>(ph) < portChangedStamp.size()) portChangedStamp[ph] = evalGeneration;
+    for (PortHandle h : inputTouched) setNodeValueAt(plan.portNode[h], inputLatest[h]);
+    return inputTouched.size();
+}
+
+bool NodeFlow::FlowEngine::postInput(PortHandle handle, float value) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (!inputQueue.push(InputCommand{handle, value, static_cast<unsigned long long>(ns)})) return false;
+    // Pairs with the fence in waitForInput: either the waiter sees the input
+    // or we see the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (wakeWaiters.load(std::memory_order_relaxed) > 0) {
+        { std::lock_guard<std::mutex> lock(wakeMutex); }
+        wakeCv.notify_one();
+    }
+    return true;
+}
+
+bool NodeFlow::FlowEngine::waitForInput(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeWaiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool woke = wakeCv.wait_until(lock, deadline, [this] { return wakePending || inputQueue.depth() > 0 || inputRingDepth() > 0; });
+    wakeWaiters.fetch_sub(1, std::memory_order_relaxed);
+    wakePending = false;
+    return woke;
+}
+
+void NodeFlow::FlowEngine::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakePending = true;
+    }
+    wakeCv.notify_one();
+}
+
+double NodeFlow::FlowEngine::nextTimerDueMs() const {
+    // Stale entries only make this early, which costs one empty tick
+    if (timerHeap.empty()) return std::numeric_limits<double>::infinity();
+    return std::max(0.0, timerHeap.front().dueMs - timerClockMs);
+}
+
+size_t NodeFlow::FlowEngine::PerfStats::latencyBucket(unsigned long long ns) {
+    if (ns < 8) return static_cast<size_t>(ns);
+    int e = 63;
+    while (!(ns >> e)) --e; // e >= 3
+    return static_cast<size_t>(8 * (e - 2)) + static_cast<size_t>((ns >> (e - 3)) & 7);
+}
+
+unsigned long long NodeFlow::FlowEngine::PerfStats::latencyPercentile(double q) const {
+    unsigned long long total = 0;
+    for (unsigned long long c : inputLatencyHist) total += c;
+    if (total == 0) return 0;
+    const unsigned long long rank = static_cast<unsigned long long>(std::ceil(q * static_cast<double>(total)));
+    unsigned long long seen = 0;
+    for (size_t b = 0; b < kLatencyBuckets; ++b) {
+        seen += inputLatencyHist[b];
+        if (seen < std::max(rank, 1ull)) continue;
+        if (b < 8) return b;
+        const int e = static_cast<int>(b / 8) + 2;
+        const unsigned long long lo = (8ull + (b & 7)) << (e - 3);
+        return lo + (1ull << (e - 3)) - 1;
+    }
+    return ~0ull;
+}
+
+// Pop everything queued (WS queue, then the shared-memory ring), keep the
+// latest value per handle, then apply each handle once in first-seen order
+size_t NodeFlow::FlowEngine::drainInputs() {
+    const size_t depth = inputQueue.depth();
+    // Records pushed while we drain wait for the next round, like the queue
+    const size_t ringDepth = inputRing ? inputRing->depth() : 0;
+    if (depth == 0 && ringDepth == 0) return 0;
+    if (depth + ringDepth > perf.inputQueueDepthMax) perf.inputQueueDepthMax = depth + ringDepth;
+    if (inputMark.size() < portDescs.size()) {
+        inputMark.resize(portDescs.size(), 0);
+        inputLatest.resize(portDescs.size(), 0.0f);
+        inputStampNs.resize(portDescs.size(), 0);
+    }
+    const Generation round = ++inputRound;
+    inputTouched.clear();
+    const auto now = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    auto take = [&](PortHandle h, float value, unsigned long long stampNs) {
+        ++perf.inputsDrained;
+        if (h < 0 || static_cast<size_t>(h) >= portDescs.size() || portDescs[h].removed) return;
+        if (inputMark[h] == round) {
+            ++perf.inputsCoalesced;
+        } else {
+            inputMark[h] = round;
+            inputTouched.push_back(h);
         }
-        // enqueue dependents for re-evaluation
-        enqueueDependents(it->id);
+        inputLatest[h] = value;
+        // Producer clocks may run a little ahead of ours; 0 means "now"
+        inputStampNs[h] = (stampNs == 0 || stampNs > now) ? now : stampNs;
+    };
+    InputCommand cmd;
+    while (inputQueue.pop(cmd)) take(cmd.handle, cmd.value, cmd.timestampNs);
+    nodeflow_shm_record rec;
+    for (size_t n = 0; n < ringDepth && inputRing->pop(rec); ++n) {
+        float v = rec.value.f;
+        if (rec.dtype == NODEFLOW_SHM_INT) v = static_cast<float>(rec.value.i);
+        else if (rec.dtype == NODEFLOW_SHM_DOUBLE) v = static_cast<float>(rec.value.d);
+        take(rec.handle, v, rec.timestamp_ns);
+    }
+    for (PortHandle h : inputTouched) {
+        setNodeValueAt(plan.portNode[h], inputLatest[h]);
+        const unsigned long long lat = now - inputStampNs[h];
+        perf.inputLatencyNsAccum += lat;
+        if (lat > perf.inputLatencyNsMax) perf.inputLatencyNsMax = lat;
+    }
+    return inputTouched.size();
+}
+
+size_t NodeFlow::FlowEngine::inputRingDepth() const {
+    return inputRing ? inputRing->depth() : 0;
+}
+
+unsigned long long NodeFlow::FlowEngine::takeInputRingDrops() {
+    return inputRing ? inputRing->takeDrops() : 0;
+}
+
+void NodeFlow::FlowEngine::setNodeValueAt(int ni, float value) {
+    Node &node = nodes[ni];
+    const NodePorts &np = plan.nodePorts[ni];
+    node.parameters["value"] = static_cast<float>(value);
+    nodeParam[ni] = static_cast<double>(value);
+    nodeParamSet[ni] = 1;
+    // Update SoA values immediately for this node's outputs (cast to each
+    // output's dtype); ports that changed propagate and schedule their consumers
+    for (PortHandle hOut = np.firstOutput; hOut < np.firstOutput + np.numOutputs; ++hOut) {
+        if (storeOutput<float>(hOut, value)) enqueueConsumers(hOut);
     }
 }
 
 void NodeFlow::FlowEngine::setNodeConfigMinMax(const std::string& nodeId, int minIntervalMs, int maxIntervalMs) {
-    auto it = std::find_if(nodes.begin(), nodes.end(), [&](const Node& n){ return n.id == nodeId; });
-    if (it == nodes.end()) return;
-    it->parameters["min_interval"] = minIntervalMs;
-    it->parameters["max_interval"] = maxIntervalMs;
+    auto itIdx = nodeIndex.find(nodeId);
+    if (itIdx == nodeIndex.end()) return;
+    Node &node = nodes[itIdx->second];
+    node.parameters["min_interval"] = minIntervalMs;
+    node.parameters["max_interval"] = maxIntervalMs;
 }
 
 // Generate a small step-function library: <baseName>_step.h/.cpp
 void NodeFlow::FlowEngine::generateStepLibrary(const std::string& baseName) const {
+    if (removedNodes > 0 || plan.levelsDirty) {
+        FlowEngine live;
+        live.loadFromJson(toJson());
+        live.generateStepLibrary(baseName);
+        return;
+    }
     const std::string headerPath = baseName + "_step.h";
     const std::string sourcePath = baseName + "_step.cpp";
     std::ofstream h(headerPath), c(sourcePath);
@@ -12,6 +12,11 @@
 #include <unordered_map>
 #include <variant>
 #include <memory>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 namespace NodeFlow {
 
@@ -22,12 +27,19 @@ using Value = std::variant<int, float, double, std::string>;
 using PortHandle = int;
 using Generation = unsigned long long;
 
+// Storage lane of a port, resolved once from its declared dtype string.
+// Unknown numeric spellings fall back to Float (matches the "float/default"
+// rule used throughout the engine).
+enum class DType : unsigned char { Int = 0, Float = 1, Double = 2, String = 3 };
+DType dtypeFromString(const std::string& dataType);
+
 // Represents a port (input or output) declared on a node
 struct Port {
     PortId id;
     std::string type; // "input" or "output"
     std::string dataType; // "int", "float", "double", "string", "async_int", etc.
     Value value;
+    double deadband = 0.0; // outputs: moves within this band of the last propagated value are ignored
 };
 
 // Represents a connection (wire) between ports
@@ -56,6 +68,8 @@ struct PortDesc {
     PortId portId;
     std::string direction; // "input" or "output"
     std::string dataType;  // base type string
+    bool removed = false;  // tombstone left by removeNode (handles are never reused)
+    double deadband = 0.0; // numeric outputs: change threshold (0 = any change)
 };
 
 struct NodeDesc {
@@ -63,12 +77,61 @@ struct NodeDesc {
     std::string type;
     std::vector<PortHandle> inputPorts;
     std::vector<PortHandle> outputPorts;
+    bool removed = false;  // tombstone left by removeNode
+};
+
+// One external input: set the node owning `handle` to `value`. timestampNs is
+// steady-clock time at push, used for ingest latency stats.
+struct InputCommand {
+    PortHandle handle = -1;
+    float value = 0.0f;
+    unsigned long long timestampNs = 0;
+};
+
+// One entry of a batched set (setNodeValues)
+struct InputValue {
+    PortHandle handle = -1;
+    float value = 0.0f;
 };
 
+// Bounded lock-free MPSC ring of input commands (one sequence number per cell).
+// Any thread may push; only the engine thread pops. A full ring rejects the
+// push and counts a drop instead of blocking the producer.
+class InputQueue {
+public:
+    explicit InputQueue(size_t capacity = 65536);
+    // Resize and clear; only while no producer or consumer is active
+    void reset(size_t capacity);
+    bool push(const InputCommand& cmd);
+    bool pop(InputCommand& out);
+    size_t depth() const;
+    size_t capacity() const { return mask + 1; }
+    unsigned long long takeDrops() { return drops.exchange(0, std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        InputCommand cmd;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0}; // next push position (producers)
+    alignas(64) std::atomic<size_t> tail{0}; // next pop position (consumer)
+    std::atomic<unsigned long long> drops{0};
+};
+
+// Thread pool used by the opt-in parallel execution mode (defined in NodeFlowCore.cpp)
+struct WorkerPool;
+// Batched N-instance engine (NodeFlowBatch.hpp); reuses the compiled plan
+class BatchFlowEngine;
+// Shared-memory input ring (NodeFlowShm.hpp), drained with the input queue
+class ShmInputRing;
+
 // FlowEngine manages the flow graph lifecycle: load, execute, describe, AOT
 class FlowEngine {
 public:
-    FlowEngine() = default;
+    FlowEngine();
+    ~FlowEngine();
     // Load a graph from JSON (nodes, ports, connections)
     void loadFromJson(const nlohmann::json& json);
     // Evaluate the graph once (non-blocking, deterministic)
@@ -87,6 +150,69 @@ public:
     // Control helpers for runtime/IPC
     // Set a node's current value (commonly DeviceTrigger). Propagates downstream.
     void setNodeValue(const std::string& nodeId, float value);
+    // Set the nodes owning each handle as one update: the latest value per
+    // handle wins and is applied once, and a consumer fed by several of them
+    // is scheduled once, so the next execute() evaluates the whole batch in
+    // one wave. Invalid or removed handles are skipped; returns how many
+    // handles were applied. Inputs already queued by postInput are drained
+    // first, so they never overwrite the batch. Same threading rules as
+    // setNodeValue.
+    size_t setNodeValues(const InputValue* values, size_t count);
+    size_t setNodeValues(const std::vector<InputValue>& values) { return setNodeValues(values.data(), values.size()); }
+    // Queue a set for the node owning `handle` from any thread without taking
+    // the engine lock. Queued inputs are applied at the start of the next
+    // execute(), latest value per handle wins. Returns false if the queue is
+    // full (the input is dropped and counted in PerfStats::inputsDropped).
+    bool postInput(PortHandle handle, float value);
+    // Apply queued inputs now (execute() does this first); returns how many
+    // handles were applied. Engine thread only.
+    size_t drainInputs();
+    // Block the engine thread until an input is queued, wake() is called or
+    // `deadline` passes. Returns false on timeout. postInput only pays for a
+    // notify while someone is waiting.
+    bool waitForInput(std::chrono::steady_clock::time_point deadline);
+    // Wake a waitForInput() caller without queueing an input (e.g. after a
+    // graph edit or a control change made from another thread)
+    void wake();
+    // Tick-clock milliseconds until the next Timer fires (infinity if none),
+    // and whether a pulse from the last tick still has to drop back to 0
+    double nextTimerDueMs() const;
+    bool timerPulseActive() const { return !timerPulsing.empty(); }
+    // True when execute() has work: queued inputs, scheduled nodes or the
+    // cold-start pass (busy-poll loops skip empty evals)
+    bool hasPendingWork() const { return coldStart || readyCount > 0 || inputQueue.depth() > 0 || inputRingDepth() > 0; }
+    // Capacity of the input queue (rounded up to a power of two). Call before
+    // any producer starts; queued inputs are discarded.
+    void setInputQueueCapacity(size_t capacity) { inputQueue.reset(capacity); }
+    // Also drain a shared-memory ring (--shm-in) in drainInputs(), after the
+    // queue and with the same coalescing. The ring must outlive the engine or
+    // be detached with nullptr; set it before execute() runs.
+    void setInputRing(ShmInputRing* ring) { inputRing = ring; }
+    // Opt-in level-synchronous parallel execution: nodes of one dependency level
+    // run across `workers` threads (caller included) with a barrier between
+    // levels. workers <= 1 keeps the serial path. Results are identical to the
+    // serial order; graphs where an input is fed by several wires stay serial.
+    void setWorkers(int workers);
+    int getWorkers() const;
+    // How dirty-driven waves use the workers. Levels: barrier per dependency
+    // level. WorkStealing (default): only the closure of the dirty nodes is
+    // visited; each node runs as soon as its affected inputs are final, via
+    // per-worker deques with stealing. Cold start always runs by levels.
+    enum class ParallelMode { Levels, WorkStealing };
+    void setParallelMode(ParallelMode mode) { parallelMode = mode; }
+    ParallelMode getParallelMode() const { return parallelMode; }
+    // Incremental graph editing: patch descriptors, adjacency and topo order
+    // in place instead of a loadFromJson rebuild. Existing node state and port
+    // handles stay valid; a removed node's handles are tombstoned (descs keep
+    // `removed = true`) and never reused. Each call throws std::runtime_error
+    // on invalid input (unknown node/port, type mismatch, cycle) and then
+    // leaves the graph unchanged. Touched nodes are evaluated on next execute.
+    void addNode(const nlohmann::json& nodeJson);
+    void removeNode(const std::string& nodeId);
+    void connect(const Connection& c);
+    void disconnect(const Connection& c);
+    // Export the live graph in the loadFromJson format
+    nlohmann::json toJson() const;
     // Update per-node timing/config parameters
     void setNodeConfigMinMax(const std::string& nodeId, int minIntervalMs, int maxIntervalMs);
 
@@ -94,8 +220,8 @@ public:
     const std::vector<NodeDesc>& getNodeDescs() const { return nodeDescs; }
     const std::vector<PortDesc>& getPortDescs() const { return portDescs; }
     int getPortHandle(const std::string& nodeId, const std::string& portId, const std::string& direction) const;
-    Value readPort(PortHandle handle) const { return (handle >= 0 && (size_t)handle < portValues.size()) ? portValues[handle] : Value{}; }
-    void writePort(PortHandle handle, const Value& v) { if (handle >= 0 && (size_t)handle < portValues.size()) portValues[handle] = v; }
+    Value readPort(PortHandle handle) const;
+    void writePort(PortHandle handle, const Value& v);
 
     // Generation counters and deltas
     // Begin a new WS snapshot epoch and return its generation
@@ -103,8 +229,42 @@ public:
     // Compatibility delta helpers for runtime/WS
     std::unordered_map<NodeId, Value> getOutputsChangedSince(Generation lastSnapshotGen) const;
     std::vector<std::tuple<NodeId, PortId, Value>> getPortDeltasChangedSince(Generation lastSnapshotGen) const;
+    // Visit each live output port whose value changed after eval generation
+    // `since`, once, in change order. Cost is O(changes since), independent of
+    // graph size; no allocation.
+    template <typename F> void forEachPortChangedSince(Generation since, F&& f) const {
+        for (size_t i = firstChangeAfter(since); i < changeLog.size(); ++i) {
+            const ChangeEntry &c = changeLog[i];
+            // Older entries of a port are superseded by its latest one
+            if (c.gen <= since || c.gen != portLoggedStamp[c.handle] || portDescs[c.handle].removed) continue;
+            f(c.handle);
+        }
+    }
     Generation currentEvalGeneration() const { return evalGeneration; }
 
+    // Published port view (RCU style). After each eval the engine fills a
+    // recycled buffer and swaps it in; readers take a reference with
+    // getSnapshot() and never wait on evaluation. A snapshot is immutable and
+    // consistent: every port reflects the same eval generation. Buffers still
+    // held by readers are never reused, so at most a few are alive.
+    struct PortSnapshot {
+        Generation generation = 0;                     // eval generation the values belong to
+        std::shared_ptr<const std::vector<PortDesc>> descs; // descriptors at publish time
+        std::vector<DType> lane;                       // port handle -> storage lane
+        std::vector<double> number;                    // port handle -> numeric value (exact for int/float)
+        std::vector<std::string> text;                 // port handle -> value of string ports
+        std::vector<Generation> changed;               // port handle -> last eval generation it changed
+        size_t size() const { return lane.size(); }
+        Value read(PortHandle h) const;
+    };
+    // Publishing is off by default (it adds a pass over the port stamps per
+    // eval); when on, execute() publishes after every eval
+    void setPublishSnapshots(bool on) { publishEnabled = on; }
+    // Publish the current state now (e.g. after an edit or a drain outside execute)
+    void publishSnapshot();
+    // Latest published view, or null before the first publish. Any thread.
+    std::shared_ptr<const PortSnapshot> getSnapshot() const;
+
     // Performance counters (lightweight; zero-alloc, resettable)
     struct PerfStats {
         unsigned long long evalCount = 0;
@@ -114,14 +274,45 @@ public:
         unsigned long long evalTimeNsAccum = 0; // total
         unsigned long long evalTimeNsMin = (unsigned long long)-1;
         unsigned long long evalTimeNsMax = 0;
+        unsigned long long tasksStolen = 0; // work-stealing mode: nodes run by a non-owning worker
+        // Input queue (postInput): commands drained, merged into a later
+        // command for the same handle, rejected because the ring was full, and
+        // the deepest backlog seen at a drain
+        unsigned long long inputsDrained = 0;
+        unsigned long long inputsCoalesced = 0;
+        unsigned long long inputsDropped = 0;
+        unsigned long long inputQueueDepthMax = 0;
+        unsigned long long inputLatencyNsAccum = 0; // push -> apply, summed over applied inputs
+        unsigned long long inputLatencyNsMax = 0;
+        // Input -> output latency: push time to the end of the execute() that
+        // applied it (outputs published). Log2 buckets, 8 linear sub-buckets
+        // each (<= 12.5% error).
+        static constexpr size_t kLatencyBuckets = 512;
+        unsigned long long inputLatencyHist[kLatencyBuckets] = {};
+        static size_t latencyBucket(unsigned long long ns);
+        // Upper bound (ns) of the bucket holding quantile q (0..1); 0 if empty
+        unsigned long long latencyPercentile(double q) const;
+        // Parallel mode only: time and node count per dependency level (levels
+        // past the last bucket are folded into it)
+        static constexpr size_t kMaxLevels = 64;
+        size_t levelsUsed = 0;
+        unsigned long long levelTimeNsAccum[kMaxLevels] = {};
+        unsigned long long levelNodes[kMaxLevels] = {};
     };
+    // Ready-set implementation. Bitset is the default; LegacyQueue is the old
+    // sorted vector, selectable for side-by-side benchmarking.
+    enum class Scheduler { Bitset, LegacyQueue };
+    void setScheduler(Scheduler s);
+    Scheduler getScheduler() const { return scheduler; }
     PerfStats getAndResetPerfStats() {
         PerfStats out = perf;
+        out.inputsDropped = inputQueue.takeDrops() + takeInputRingDrops();
         perf = PerfStats{};
         return out;
     }
 
 private:
+    friend class BatchFlowEngine;
     std::vector<Node> nodes;
     std::vector<Connection> connections;
     std::vector<NodeId> executionOrder;
@@ -131,33 +322,272 @@ private:
     std::vector<PortDesc> portDescs;
     std::unordered_map<std::string, PortHandle> portKeyToHandle; // key: nodeId+":"+portId+":"+direction
 
-    // Generations and change tracking (per-node first output)
+    // Generations and change tracking (per output port)
     Generation evalGeneration = 1;
     Generation snapshotGeneration = 0;
-    std::unordered_map<NodeId, Generation> outputChangedStamp; // nodeId -> last eval gen when its primary output changed
-    std::vector<Generation> portChangedStamp; // per port handle
-    std::vector<Value> portValues; // current port values by handle (SoA seed)
-    std::vector<std::vector<PortHandle>> outToIn; // output handle -> list of input handles
-    std::unordered_map<NodeId, std::vector<PortHandle>> nodeOutputHandles; // node -> its output handles
-
-    // Deterministic scheduling scaffolding (ready-queue, topo index)
-    std::unordered_map<NodeId, std::vector<NodeId>> dependents; // nodeId -> downstream nodes
-    std::unordered_map<NodeId, int> topoIndex; // nodeId -> topological order index
-    std::unordered_map<NodeId, size_t> nodeIndex; // nodeId -> index in nodes vector
-    std::vector<NodeId> readyQueue;
-    std::unordered_map<NodeId, Generation> readyStamp;
+    std::vector<Generation> portChangedStamp; // port handle -> last eval gen its value changed
+    std::vector<double> portDeadband;         // port handle -> deadband of numeric outputs (0 = exact)
+    // Append-only change log (compacted when it outgrows the graph): one entry
+    // each time a port's stamp advances. `seq` is the running max of `gen`,
+    // so the log is sorted by it even though a tick stamps the next
+    // generation before later setNodeValue calls stamp the current one.
+    struct ChangeEntry { PortHandle handle; Generation gen; Generation seq; };
+    std::vector<ChangeEntry> changeLog;
+    std::vector<Generation> portLoggedStamp;  // port handle -> stamp of its latest log entry
+    bool deferChangeLog = false;              // parallel pass: workers stamp, caller logs after
+    void markChanged(PortHandle h, Generation gen) {
+        if (portChangedStamp[h] >= gen) return;
+        portChangedStamp[h] = gen;
+        if (!deferChangeLog) logChange(h);
+    }
+    void logChange(PortHandle h);
+    void logNodeChanges(int ni);
+    size_t firstChangeAfter(Generation since) const;
+
+    // Typed port storage (SoA lanes). Each handle owns one slot in the lane of
+    // its declared dtype; numeric lanes are dense arrays, strings live in a
+    // side table that the compute path never touches.
+    struct PortSlot { DType lane; unsigned int slot; };
+    std::vector<PortSlot> portSlot;        // port handle -> (lane, slot)
+    std::vector<int> laneInt;
+    std::vector<float> laneFloat;
+    std::vector<double> laneDouble;
+    std::vector<std::string> laneString;
+    std::unordered_map<NodeId, size_t> nodeIndex; // nodeId -> index in nodes vector (API boundary only)
+
+    // Integer-indexed execution plan, compiled once by loadFromJson. The hot
+    // path (execute/tick/setNodeValue) only touches these flat arrays: no
+    // string keys, hashing or linear searches.
+    struct NodePorts {
+        PortHandle firstInput = 0;  // inputs occupy [firstInput, firstInput + numInputs)
+        int numInputs = 0;
+        PortHandle firstOutput = 0; // outputs occupy [firstOutput, firstOutput + numOutputs)
+        int numOutputs = 0;
+    };
+    // Adjacency rows packed in one array like CSR, but each row has a capacity
+    // so edits patch it in place: a full row moves to the end of the array
+    // (its old range becomes a hole until compactIfSparse()). Rows iterate as
+    // [begin(r), end(r)); erase keeps the remaining entries in order.
+    template <typename T>
+    struct RowTable {
+        std::vector<int> start, len, cap;
+        std::vector<T> items;
+        size_t holes = 0;
+        int begin(int r) const { return start[r]; }
+        int end(int r) const { return start[r] + len[r]; }
+        // Lay out rows back to back with the given capacities (load path)
+        void build(const std::vector<int> &capacity) {
+            start.assign(capacity.size(), 0); len.assign(capacity.size(), 0); cap = capacity;
+            int total = 0;
+            for (size_t r = 0; r < capacity.size(); ++r) { start[r] = total; total += capacity[r]; }
+            items.assign(static_cast<size_t>(total), T{});
+            holes = 0;
+        }
+        void addRow() { start.push_back(static_cast<int>(items.size())); len.push_back(0); cap.push_back(0); }
+        void push(int r, const T &v) {
+            if (len[r] == cap[r]) {
+                const int newCap = cap[r] ? cap[r] * 2 : 2;
+                const int newStart = static_cast<int>(items.size());
+                items.resize(items.size() + static_cast<size_t>(newCap));
+                std::copy(items.begin() + start[r], items.begin() + start[r] + len[r], items.begin() + newStart);
+                holes += static_cast<size_t>(cap[r]);
+                start[r] = newStart;
+                cap[r] = newCap;
+            }
+            items[static_cast<size_t>(start[r] + len[r]++)] = v;
+        }
+        void eraseAt(int r, int e) {
+            std::copy(items.begin() + e + 1, items.begin() + end(r), items.begin() + e);
+            --len[r];
+        }
+        // Drop holes and spare capacity once they dominate the array
+        void compactIfSparse() {
+            if (holes * 2 <= items.size()) return;
+            std::vector<T> packed;
+            packed.reserve(items.size() - holes);
+            for (size_t r = 0; r < start.size(); ++r) {
+                const int s = static_cast<int>(packed.size());
+                packed.insert(packed.end(), items.begin() + start[r], items.begin() + start[r] + len[r]);
+                start[r] = s;
+                cap[r] = len[r];
+            }
+            items.swap(packed);
+            holes = 0;
+        }
+    };
+    struct EdgeTarget {
+        PortHandle input = 0;   // input handle fed by the wire
+        unsigned int slot = 0;  // its slot in its lane
+        unsigned char cast = 0; // EdgeCast from source lane to target lane
+    };
+    struct DependentEdge {
+        int node = 0;  // downstream node index
+        int wires = 0; // parallel wires collapsed into this entry
+    };
+    struct ExecPlan {
+        std::vector<NodePorts> nodePorts;    // node index -> port handle ranges
+        std::vector<int> portNode;           // port handle -> owning node index
+        std::vector<int> topoOrder;          // topo position -> node index (-1: removed node)
+        std::vector<int> topoIndex;          // node index -> topo position (-1: removed)
+        RowTable<EdgeTarget> outToIn;        // rows per port handle: wires out of each output
+        RowTable<DependentEdge> dependents;  // rows per node index: downstream nodes (deduplicated)
+        RowTable<DependentEdge> precedents;  // rows per node index: upstream nodes (mirror of dependents)
+        std::vector<int> inputWires;         // port handle -> wires feeding it (inputs)
+        int multiFedInputs = 0;              // inputs fed by more than one wire (parallel needs 0)
+        std::vector<unsigned char> kernel;   // node index -> Kernel opcode
+        std::vector<int> timerNodes;         // node indices driven by tick()
+        std::vector<int> levelOffsets;       // level -> first topo position (size levels + 1)
+        bool levelsDirty = false;            // edits since the last level-major layout
+    } plan;
+    size_t removedNodes = 0;
+    // Scratch for reorderForEdge, kept across calls so edits do not allocate
+    std::vector<unsigned char> orderMark;  // node index -> visited by the current repair
+    std::vector<int> orderStack, orderFwd, orderBwd, orderSlots;
+
+    // Deterministic scheduling: a dirty bitset indexed by topo position. Enqueue
+    // sets a bit (O(1), dedup for free); pop scans forward from readyCursor for
+    // the lowest set bit, which is exactly the next node in topo order.
+    std::vector<unsigned long long> readyBits; // bit p set => plan.topoOrder[p] is ready
+    size_t readyCursor = 0;                    // lowest word that may hold a set bit
+    size_t readyCount = 0;
+    // Legacy sorted queue (stable_sort per enqueue, erase-front pop); kept only
+    // as the --bench reference. Membership still goes through readyBits.
+    std::vector<int> legacyQueue;
+    Scheduler scheduler = Scheduler::Bitset;
     bool coldStart = true;
 
+    // Parallel execution (see setWorkers)
+    std::unique_ptr<WorkerPool> pool;
+    std::vector<int> levelBatch;               // ready nodes of the level being evaluated
+    std::vector<unsigned char> levelChanged;   // per levelBatch entry: some output changed
+    ParallelMode parallelMode = ParallelMode::WorkStealing;
+    // Work-stealing wave state, sized per graph. A wave is the closure of the
+    // dirty nodes; wavePending counts a node's in-wave predecessors still
+    // running and waveDirty records that one of them changed (or it is a seed).
+    struct StealDeque;
+    std::vector<std::unique_ptr<StealDeque>> stealDeques; // one per worker
+    std::unique_ptr<std::atomic<int>[]> wavePending;
+    std::unique_ptr<std::atomic<unsigned char>[]> waveDirty;
+    size_t waveCapacity = 0;                              // allocated length of the two arrays above
+    std::vector<Generation> waveMark;                     // node index -> eval gen when added to a wave
+    std::vector<int> waveNodes;                           // affected set of the current wave
+    std::vector<unsigned long long> workerEvaluated, workerStolen; // per worker, folded into perf
+
     // Perf counters (mutated inside execute and enqueue)
     PerfStats perf;
 
     // Per-node state for time-based/edge-detect nodes
-    std::vector<double> timerAccumMs;      // per Timer node accumulator
+    // Timer schedule: a min-heap of next due times on the tick clock, so
+    // tick() only touches timers that fire or end a pulse. A timer fires when
+    // the clock reaches timerBaseMs + interval, at most once per tick, and its
+    // base then advances by one interval (same as the old accumulator).
+    struct TimerDue {
+        double dueMs; int node; unsigned int arm;
+        bool operator>(const TimerDue &o) const { return dueMs != o.dueMs ? dueMs > o.dueMs : node > o.node; }
+    };
+    std::vector<TimerDue> timerHeap;
+    double timerClockMs = 0.0;
+    std::vector<double> timerBaseMs;       // per Timer node clock at its last fire (or arm)
+    std::vector<unsigned int> timerArm;    // per Timer node; heap entries of older arms are stale
+    std::vector<int> timerPulsing;         // Timers whose output went to 1 on the previous tick
+    std::vector<int> timerFired;           // scratch: Timers fired this tick
+    void armTimer(int ni);
     std::vector<int> counterLastTick;      // per Counter node last input (>0 => 1, else 0)
     std::vector<double> counterValue;      // per Counter node current value (double for uniformity)
 
-    void enqueueNode(const NodeId& id);
-    void enqueueDependents(const NodeId& id);
+    // Snapshot publication (see getSnapshot). publishEpoch is bumped whenever
+    // values or descriptors may change without a port stamp (load, edits,
+    // writePort); a buffer from an older epoch is refilled in full, otherwise
+    // only ports stamped after its generation are copied.
+    bool publishEnabled = false;
+    unsigned long long publishEpoch = 1;
+    unsigned long long descsEpoch = 0;
+    std::shared_ptr<const std::vector<PortDesc>> publishedDescs;
+    struct SnapshotBuffer {
+        std::shared_ptr<PortSnapshot> snap;
+        unsigned long long epoch = 0;
+    };
+    SnapshotBuffer snapshotPool[3];
+    std::shared_ptr<const PortSnapshot> published; // std::atomic_load/store only
+    void snapshotPort(PortSnapshot& s, PortHandle h) const;
+
+    // External input ingestion (see postInput). inputMark dedups handles per
+    // drain so only the latest value of each is applied.
+    InputQueue inputQueue;
+    ShmInputRing* inputRing = nullptr;     // optional; not owned
+    size_t inputRingDepth() const;
+    unsigned long long takeInputRingDrops();
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    std::atomic<int> wakeWaiters{0};
+    bool wakePending = false;              // guarded by wakeMutex
+    std::vector<Generation> inputMark;     // port handle -> drain round it was last seen in
+    Generation inputRound = 0;
+    std::vector<float> inputLatest;        // port handle -> latest value this drain
+    std::vector<unsigned long long> inputStampNs; // port handle -> push time of that value
+    std::vector<PortHandle> inputTouched;  // handles seen this drain, first-seen order
+
+    // Per-node "value" parameter resolved at load for Value/DeviceTrigger
+    // (kept in sync by setNodeValue)
+    std::vector<double> nodeParam;
+    std::vector<unsigned char> nodeParamSet; // 1 if nodeParam holds a configured value
+    // Per-node "interval_ms" for Timer, resolved at load; input sets never touch it
+    std::vector<double> timerIntervalMs;
+
+    // Node kernel opcode, resolved once from (type, primary output dtype)
+    enum Kernel : unsigned char {
+        KernelValue, KernelValueString,
+        KernelDeviceTrigger, KernelDeviceTriggerString,
+        KernelAddInt, KernelAddFloat, KernelAddDouble, KernelAddString,
+        KernelCounter, KernelTimer
+    };
+
+    // Lane-to-lane copy precomputed per edge (numeric: src * 3 + dst)
+    enum EdgeCast : unsigned char {
+        IntToInt, IntToFloat, IntToDouble,
+        FloatToInt, FloatToFloat, FloatToDouble,
+        DoubleToInt, DoubleToFloat, DoubleToDouble,
+        StringToString
+    };
+
+    // Typed lane access by handle (cast to/from the port's lane)
+    template <typename T> T loadAs(PortHandle h) const;
+    template <typename T> void storeAs(PortHandle h, T v);
+    // Kernel output writes: compare, store, and stamp/propagate on change
+    template <typename T> bool storeOutput(PortHandle h, T v);
+    bool storeOutputString(PortHandle h, const std::string& v);
+    PortSlot allocateSlot(DType lane);
+    // Resolve node ni's kernel and parameters; throws on unknown node types
+    void resolveKernel(int ni);
+    // Parse one node JSON and append it (descriptors, handles, lanes, kernel);
+    // returns its node index. Adjacency rows and per-node state are the caller's.
+    int appendNode(const nlohmann::json& nodeJson);
+    // Resolve and type-check a connection's handles; throws on failure
+    std::pair<PortHandle, PortHandle> resolveConnection(const Connection& c) const;
+    EdgeTarget edgeTarget(PortHandle hOut, PortHandle hIn) const;
+    void linkEdge(PortHandle hOut, PortHandle hIn);
+    void unlinkEdge(PortHandle hOut, PortHandle hIn);
+    // Grow per-node state (stamps, timers, counters, wave arrays) to nodes.size()
+    void growNodeState();
+    // Kahn over live nodes, laid out level-major; throws on cycles. Pending
+    // ready nodes keep their bits across the relayout.
+    void orderNodes();
+    // Pearce-Kelly repair after wiring u -> v: only nodes whose positions lie
+    // between v and u are visited and shuffled. Throws on a cycle (the edge
+    // is still linked; the caller unlinks it).
+    void reorderForEdge(int u, int v, const Connection& c);
+    bool evalNode(int ni);
+    void executeLevels();
+    void takeReadyRange(int begin, int end);
+    void executeStealing();
+    // Copy an output's current value to every input wired to it
+    void propagateOutput(PortHandle hOut);
+    void enqueueNode(int node);
+    void setNodeValueAt(int ni, float value);
+    void enqueueConsumers(PortHandle hOut);
+    void enqueueChangedConsumers(int ni);
+    int popReady(); // next ready node index in topo order, or -1
+    void clearReady();
 
     void computeExecutionOrder();
 };
@@ -0,0 +1,137 @@
+// NodeFlow pending WS delta
+//
+// Per-port accumulator behind the runtime's WS deltas (--ws-delta-fast and
+// the flush loop). Header-only so the allocation test can exercise the same
+// code without the WS server.
+#pragma once
+#include "NodeFlowCore.hpp"
+#include "NodeFlowWire.hpp"
+#include <fmt/format.h>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NodeFlow {
+
+// Numeric value of an int/float/double Value; false for strings
+inline bool numericValue(const Value &v, double &out) {
+    if (std::holds_alternative<int>(v)) out = std::get<int>(v);
+    else if (std::holds_alternative<float>(v)) out = std::get<float>(v);
+    else if (std::holds_alternative<double>(v)) out = std::get<double>(v);
+    else return false;
+    return true;
+}
+
+// Append s as a quoted JSON string
+inline void appendJsonString(std::string &out, const std::string &s) {
+    out.push_back('"');
+    for (char c : s) { if (c=='"' || c=='\\') out.push_back('\\'); out.push_back(c);} 
+    out.push_back('"');
+}
+
+// Pending WS delta indexed by port handle: the latest value of each port
+// changed since the last flush in typed slots, plus the changed handles in
+// first-change order. Values are formatted only when a delta is written, into
+// the caller's reusable buffer. The epsilon filter compares numeric ports with
+// the value last *sent*, so slow drifts still go out once they add up. Storage
+// is sized by the port table, never per change, so steady state allocates
+// nothing (string ports aside, which copy their text).
+class PendingDelta {
+public:
+    // Track a port table; a new table (load or edit) drops all state
+    void layout(const std::shared_ptr<const std::vector<PortDesc>> &portDescs) {
+        if (portDescs == descs) return;
+        descs = portDescs;
+        const size_t n = descs ? descs->size() : 0;
+        type.assign(n, DType::Float);
+        number.assign(n, 0.0);
+        text.assign(n, std::string());
+        sent.assign(n, 0.0);
+        sentValid.assign(n, 0);
+        state.assign(n, kIdle);
+        changedList.clear();
+        changedList.reserve(n);
+        live = 0;
+    }
+    void record(PortHandle h, const Value &v, double epsilon) {
+        const size_t i = static_cast<size_t>(h);
+        if (h < 0 || i >= state.size()) return;
+        type[i] = static_cast<DType>(v.index()); // Value alternatives follow DType order
+        if (type[i] == DType::String) {
+            text[i] = std::get<std::string>(v);
+        } else {
+            numericValue(v, number[i]);
+            // Within the band of what clients last got: nothing to send
+            if (epsilon > 0.0 && sentValid[i] && std::abs(number[i] - sent[i]) < epsilon) {
+                if (state[i] == kPending) { state[i] = kWithdrawn; --live; }
+                return;
+            }
+        }
+        if (state[i] == kIdle) changedList.push_back(h);
+        if (state[i] != kPending) ++live;
+        state[i] = kPending;
+    }
+    bool empty() const { return live == 0; }
+    size_t size() const { return live; }
+    bool pending(PortHandle h) const { return h >= 0 && static_cast<size_t>(h) < state.size() && state[h] == kPending; }
+    // Candidates in change order; skip the ones no longer pending()
+    const std::vector<PortHandle> &changed() const { return changedList; }
+    // ,"node:port":value
+    void appendJson(std::string &out, PortHandle h) const {
+        const auto &p = (*descs)[h];
+        out += ",\"";
+        out += p.nodeId;
+        out.push_back(':');
+        out += p.portId;
+        out += "\":";
+        appendValue(out, h);
+    }
+    // Same number formatting as jsonNumberForDtype(dtype, v, 3)
+    void appendValue(std::string &out, PortHandle h) const {
+        switch (type[h]) {
+            case DType::Int: fmt::format_to(std::back_inserter(out), "{}", static_cast<int>(number[h])); break;
+            case DType::String: appendJsonString(out, text[h]); break;
+            default: fmt::format_to(std::back_inserter(out), "{:.3g}", number[h]); break;
+        }
+    }
+    void addBinary(Wire::FrameWriter &w, PortHandle h) const {
+        const auto u = static_cast<std::uint32_t>(h);
+        if (type[h] == DType::String) w.addString(u, text[h]);
+        else w.addNumber(u, static_cast<Wire::Tag>(type[h]), number[h]);
+    }
+    // Owned copies, for per-client backlogs
+    std::string key(PortHandle h) const { return (*descs)[h].nodeId + ":" + (*descs)[h].portId; }
+    std::string json(PortHandle h) const { std::string s; appendValue(s, h); return s; }
+    Value value(PortHandle h) const {
+        switch (type[h]) {
+            case DType::Int: return static_cast<int>(number[h]);
+            case DType::Float: return static_cast<float>(number[h]);
+            case DType::Double: return number[h];
+            default: return text[h];
+        }
+    }
+    // The flush went out: pending values become the epsilon reference
+    void markSent() {
+        for (auto h : changedList) {
+            if (state[h] == kPending && type[h] != DType::String) { sent[h] = number[h]; sentValid[h] = 1; }
+            state[h] = kIdle;
+        }
+        changedList.clear();
+        live = 0;
+    }
+
+private:
+    enum : unsigned char { kIdle, kPending, kWithdrawn }; // withdrawn: listed, back within the band
+    std::shared_ptr<const std::vector<PortDesc>> descs;
+    std::vector<DType> type;
+    std::vector<double> number; // exact for int/float
+    std::vector<std::string> text;
+    std::vector<double> sent;
+    std::vector<unsigned char> sentValid, state;
+    std::vector<PortHandle> changedList;
+    size_t live = 0;
+};
+
+} // namespace NodeFlow
@@ -0,0 +1,100 @@
+// NodeFlowShm.cpp
+//
+// Shared-memory ingress ring (see nodeflow_shm.h for the layout and the
+// producer side). The consumer mirrors the producers' per-cell sequence
+// protocol: a cell is readable once its sequence is pos + 1 and is handed
+// back for the next lap by setting it to pos + capacity.
+#include "NodeFlowShm.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace NodeFlow {
+
+ShmInputRing::ShmInputRing(const std::string& name, size_t capacity) : segName(name) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    if (cap > 0x80000000u) throw std::runtime_error("shm-in: capacity too large");
+    const size_t bytes = nodeflow_shm_in_bytes(static_cast<uint32_t>(cap));
+    shm_unlink(name.c_str()); // a stale ring from a previous run
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) throw std::runtime_error("shm-in: cannot create " + name + ": " + std::strerror(errno));
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        const int err = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("shm-in: cannot size " + name + ": " + std::strerror(err));
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("shm-in: cannot map " + name);
+    }
+    ring.hdr = static_cast<nodeflow_shm_in_header*>(p);
+    ring.cells = reinterpret_cast<nodeflow_shm_cell*>(static_cast<char*>(p) + sizeof(nodeflow_shm_in_header));
+    ring.bytes = bytes;
+    std::memset(p, 0, sizeof(nodeflow_shm_in_header));
+    for (size_t i = 0; i < cap; ++i) ring.cells[i].seq = i;
+    ring.hdr->capacity = static_cast<uint32_t>(cap);
+    ring.hdr->record_size = sizeof(nodeflow_shm_record);
+    ring.hdr->version = NODEFLOW_SHM_IN_VERSION;
+    // Producers check the magic last
+    __atomic_store_n(&ring.hdr->magic, NODEFLOW_SHM_IN_MAGIC, __ATOMIC_RELEASE);
+}
+
+ShmInputRing::~ShmInputRing() {
+    nodeflow_shm_in_close(&ring);
+    shm_unlink(segName.c_str());
+}
+
+bool ShmInputRing::pop(nodeflow_shm_record& out) {
+    nodeflow_shm_in_header* h = ring.hdr;
+    const uint64_t pos = h->tail; // only this thread writes it
+    nodeflow_shm_cell& c = ring.cells[pos & (h->capacity - 1)];
+    if (__atomic_load_n(&c.seq, __ATOMIC_ACQUIRE) != pos + 1) return false;
+    out = c.rec;
+    __atomic_store_n(&c.seq, pos + h->capacity, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->tail, pos + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+size_t ShmInputRing::depth() const {
+    const uint64_t head = __atomic_load_n(&ring.hdr->head, __ATOMIC_RELAXED);
+    const uint64_t tail = __atomic_load_n(&ring.hdr->tail, __ATOMIC_RELAXED);
+    return head > tail ? static_cast<size_t>(head - tail) : 0;
+}
+
+unsigned long long ShmInputRing::consumed() const {
+    return __atomic_load_n(&ring.hdr->tail, __ATOMIC_RELAXED);
+}
+
+unsigned long long ShmInputRing::takeDrops() {
+    return __atomic_exchange_n(&ring.hdr->dropped, 0, __ATOMIC_RELAXED);
+}
+
+bool ShmInputRing::waitForData(std::chrono::milliseconds timeout) {
+    nodeflow_shm_in_header* h = ring.hdr;
+    __atomic_store_n(&h->sleeping, 1, __ATOMIC_RELAXED);
+    // Pairs with the producers' fence after publishing: either we see their
+    // record here or they see `sleeping` and bump the wake word
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const uint32_t seen = __atomic_load_n(&h->wake, __ATOMIC_RELAXED);
+    if (depth() == 0) {
+#if defined(__linux__)
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+        ts.tv_nsec = static_cast<long>((timeout.count() % 1000) * 1000000);
+        syscall(SYS_futex, &h->wake, FUTEX_WAIT, seen, &ts, nullptr, 0);
+#else
+        (void)seen;
+        const auto until = std::chrono::steady_clock::now() + timeout;
+        while (depth() == 0 && std::chrono::steady_clock::now() < until) std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+    }
+    __atomic_store_n(&h->sleeping, 0, __ATOMIC_RELAXED);
+    return depth() > 0;
+}
+
+} // namespace NodeFlow
@@ -0,0 +1,44 @@
+// NodeFlow shared-memory ingress
+//
+// Runtime end of the --shm-in ring: creates the POSIX shared-memory segment
+// laid out by nodeflow_shm.h (which producers include) and pops its records
+// for the engine. Single consumer: only the engine thread pops; waitForData()
+// may run on one other thread to turn producer pushes into engine wakeups.
+#pragma once
+#include "nodeflow_shm.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace NodeFlow {
+
+class ShmInputRing {
+public:
+    // Create (replacing any stale segment of that name) a ring of `capacity`
+    // cells, rounded up to a power of two. Throws std::runtime_error.
+    ShmInputRing(const std::string& name, size_t capacity);
+    // Unmaps and unlinks the segment; attached producers keep their mapping
+    ~ShmInputRing();
+    ShmInputRing(const ShmInputRing&) = delete;
+    ShmInputRing& operator=(const ShmInputRing&) = delete;
+
+    // Engine thread only
+    bool pop(nodeflow_shm_record& out);
+    // Records queued (racy snapshot, exact when producers are idle)
+    size_t depth() const;
+    // Records popped so far
+    unsigned long long consumed() const;
+    unsigned long long takeDrops();
+    // Block until a record is queued or `timeout` passes; true if records are
+    // queued. A futex on the header's wake word on Linux, short sleeps elsewhere.
+    bool waitForData(std::chrono::milliseconds timeout);
+
+    const std::string& name() const { return segName; }
+    size_t capacity() const { return ring.hdr->capacity; }
+
+private:
+    std::string segName;
+    nodeflow_shm_in ring{};
+};
+
+} // namespace NodeFlow
@@ -0,0 +1,111 @@
+// NodeFlow binary wire format
+//
+// Optional binary framing for WS snapshots and deltas, negotiated per
+// connection with {"type":"subscribe","format":"binary"}. The schema and all
+// replies stay JSON; only snapshot/delta payloads change. A frame is a fixed
+// header followed by packed records keyed by port handle (from the schema),
+// all little-endian:
+//
+//   header  u8 'N', u8 'F', u8 version (1), u8 kind (1 snapshot, 2 delta),
+//           u32 record count, u64 sequence, u64 eval generation   (24 bytes)
+//   record  u32 handle, u8 tag, value
+//           tag 0 int -> i32, 1 float -> f32, 2 double -> f64,
+//           3 string -> u32 byte length + UTF-8 bytes
+//
+// Tags match NodeFlow::DType. Header-only and independent of the engine so
+// the AOT host can use it too.
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace NodeFlow {
+namespace Wire {
+
+enum class Kind : std::uint8_t { Snapshot = 1, Delta = 2 };
+enum class Tag : std::uint8_t { Int = 0, Float = 1, Double = 2, String = 3 };
+
+constexpr std::uint8_t kVersion = 1;
+constexpr std::size_t kHeaderBytes = 24;
+constexpr unsigned char kBinaryOpcode = 130; // WS fin + binary frame (text is 129)
+
+// Tag for a schema dtype string ("int", "float", "double", "string")
+inline Tag tagForDtype(const char* dtype) {
+    if (!dtype) return Tag::Float;
+    if (std::strcmp(dtype, "int") == 0) return Tag::Int;
+    if (std::strcmp(dtype, "double") == 0) return Tag::Double;
+    if (std::strcmp(dtype, "string") == 0) return Tag::String;
+    return Tag::Float;
+}
+
+// Builds one frame into a reusable buffer: begin(), add records, finish()
+class FrameWriter {
+public:
+    void begin(Kind kind, std::uint64_t seq, std::uint64_t generation) {
+        buf.clear();
+        count = 0;
+        buf.push_back('N');
+        buf.push_back('F');
+        buf.push_back(static_cast<char>(kVersion));
+        buf.push_back(static_cast<char>(kind));
+        putLE<std::uint32_t>(0); // patched by finish()
+        putLE(seq);
+        putLE(generation);
+    }
+    void addInt(std::uint32_t handle, std::int32_t v) { record(handle, Tag::Int); putLE(static_cast<std::uint32_t>(v)); }
+    void addFloat(std::uint32_t handle, float v) {
+        std::uint32_t bits; std::memcpy(&bits, &v, sizeof bits);
+        record(handle, Tag::Float); putLE(bits);
+    }
+    void addDouble(std::uint32_t handle, double v) {
+        std::uint64_t bits; std::memcpy(&bits, &v, sizeof bits);
+        record(handle, Tag::Double); putLE(bits);
+    }
+    void addString(std::uint32_t handle, std::string_view s) {
+        record(handle, Tag::String);
+        putLE(static_cast<std::uint32_t>(s.size()));
+        buf.append(s.data(), s.size());
+    }
+    // Numeric value stored in the port's declared type
+    void addNumber(std::uint32_t handle, Tag tag, double v) {
+        switch (tag) {
+            case Tag::Int: addInt(handle, static_cast<std::int32_t>(v)); break;
+            case Tag::Double: addDouble(handle, v); break;
+            default: addFloat(handle, static_cast<float>(v)); break;
+        }
+    }
+    std::uint32_t records() const { return count; }
+    // Overwrite the header sequence (e.g. once a frame turns out non-empty)
+    void setSequence(std::uint64_t seq) {
+        for (int i = 0; i < 8; ++i) buf[8 + i] = static_cast<char>((seq >> (8 * i)) & 0xFF);
+    }
+    // Patch the record count; the frame stays valid until the next begin()
+    const std::string& finish() {
+        for (int i = 0; i < 4; ++i) buf[4 + i] = static_cast<char>((count >> (8 * i)) & 0xFF);
+        return buf;
+    }
+
+private:
+    template <typename U> void putLE(U v) {
+        for (std::size_t i = 0; i < sizeof(U); ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+    void record(std::uint32_t handle, Tag tag) {
+        putLE(handle);
+        buf.push_back(static_cast<char>(tag));
+        ++count;
+    }
+    std::string buf;
+    std::uint32_t count = 0;
+};
+
+// A snapshot/delta in the formats connected clients asked for; either part is
+// empty when no client uses it
+struct Message {
+    std::string text;
+    std::string binary;
+    bool empty() const { return text.empty() && binary.empty(); }
+};
+
+} // namespace Wire
+} // namespace NodeFlow
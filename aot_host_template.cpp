@@ -9,7 +9,17 @@
 #include <chrono>
 #include <mutex>
 #include <unordered_map>
+#include <atomic>
 #include <CLI/CLI.hpp>
+#include "NodeFlowWire.hpp"
+#include "nodeflow_shm.h"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "third_party/Simple-WebSocket-Server/server_ws.hpp"
 
 #ifndef STEP_HEADER
@@ -80,6 +90,74 @@ static int parseIntArg(int argc, char** argv, const char* name, int defVal) {
     return defVal;
 }
 
+// Pin the calling thread to one core (--spin); false where affinity is unsupported
+static bool pinCurrentThread(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+// Let a thread run anywhere except `core`, keeping it off the spinning step loop
+static void keepThreadOffCore(std::thread &th, int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    const int n = static_cast<int>(std::thread::hardware_concurrency());
+    for (int c = 0; c < n; ++c) if (c != core) CPU_SET(c, &set);
+    if (CPU_COUNT(&set) > 0) pthread_setaffinity_np(th.native_handle(), sizeof(set), &set);
+#else
+    (void)th; (void)core;
+#endif
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Input -> output latency histogram (same log2 x 8 buckets as the runtime's
+// PerfStats). Written by the step loop, read and reset by the perf writer.
+struct LatencyHistogram {
+    static constexpr size_t kBuckets = 512;
+    std::atomic<unsigned long long> counts[kBuckets] = {};
+    static size_t bucket(unsigned long long ns) {
+        if (ns < 8) return static_cast<size_t>(ns);
+        int e = 63;
+        while (!(ns >> e)) --e;
+        return static_cast<size_t>(8 * (e - 2)) + static_cast<size_t>((ns >> (e - 3)) & 7);
+    }
+    static unsigned long long upperBound(size_t b) {
+        if (b < 8) return b;
+        const int e = static_cast<int>(b / 8) + 2;
+        return ((8ull + (b & 7)) << (e - 3)) + (1ull << (e - 3)) - 1;
+    }
+    void record(unsigned long long ns) { counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed); }
+    // Take and clear the counts
+    std::vector<unsigned long long> take() {
+        std::vector<unsigned long long> out(kBuckets);
+        for (size_t b = 0; b < kBuckets; ++b) out[b] = counts[b].exchange(0, std::memory_order_relaxed);
+        return out;
+    }
+    static unsigned long long percentile(const std::vector<unsigned long long> &h, double q) {
+        unsigned long long total = 0;
+        for (auto c : h) total += c;
+        if (total == 0) return 0;
+        const unsigned long long rank = std::max(1ull, static_cast<unsigned long long>(q * static_cast<double>(total) + 0.999999));
+        unsigned long long seen = 0;
+        for (size_t b = 0; b < kBuckets; ++b) { seen += h[b]; if (seen >= rank) return upperBound(b); }
+        return upperBound(kBuckets - 1);
+    }
+};
+
 int main(int argc, char** argv) {
     // CLI11: parse options
     int rateHz = 0;
@@ -109,6 +187,10 @@ int main(int argc, char** argv) {
     std::string clockType = "wall"; // wall|virtual
     double timeScale = 1.0;
     int fixedRateHz = 0;           // virtual fixed-step Hz (0=off)
+    // Busy-poll mode
+    bool spin = false;             // step on input arrival from a spinning, optionally pinned thread
+    int spinCore = -1;             // core for the step loop (-1 = no pinning)
+    std::string shmOut;            // shared-memory output mirror name; empty = off
 
     CLI::App app{"NodeFlow AOT Host"};
     try {
@@ -138,6 +220,9 @@ int main(int argc, char** argv) {
         app.add_option("--clock", clockType, "Clock type: wall|virtual");
         app.add_option("--time-scale", timeScale, "Time scale multiplier (0..N)");
         app.add_option("--ws-fixed-rate", fixedRateHz, "Virtual clock fixed step Hz (0=off)");
+        app.add_flag("--spin", spin, "Busy-poll: step immediately when a WS input arrives (tick at --rate, default 1000 Hz)");
+        app.add_option("--spin-core", spinCore, "Pin the --spin step loop to this core; WS threads avoid it");
+        app.add_option("--shm-out", shmOut, "Mirror output values into shared memory of this name after each step (nodeflow_shm.h)");
         app.allow_extras();
         app.parse(argc, argv);
     } catch (const CLI::ParseError &e) {
@@ -243,6 +328,52 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    // Optional output mirror (--shm-out, layout in nodeflow_shm.h): slots by
+    // handle from NODEFLOW_PORTS. There is no change log here, so each step
+    // compares every output with its mirrored value and publishes the ones
+    // that moved. Always called under hostMutex (single writer).
+    nodeflow_shm_out shmMirror{};
+    unsigned long long mirrorSteps = 0;
+    std::vector<uint32_t> mirrorKind(NODEFLOW_NUM_PORTS > 0 ? NODEFLOW_NUM_PORTS : 0);
+    if (!shmOut.empty()) {
+        uint32_t slots = 0;
+        for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) slots = std::max(slots, static_cast<uint32_t>(NODEFLOW_PORTS[i].handle) + 1);
+        if (nodeflow_shm_out_create(&shmMirror, shmOut.c_str(), slots) != 0) {
+            fmt::print("[host] shm-out: cannot create {}\n", shmOut);
+            return 1;
+        }
+        for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
+            const auto &p = NODEFLOW_PORTS[i];
+            mirrorKind[i] = static_cast<uint32_t>(NodeFlow::Wire::tagForDtype(p.dtype)); // tags follow NODEFLOW_SHM_*
+            nodeflow_shm_out_describe(&shmMirror, static_cast<uint32_t>(p.handle), mirrorKind[i], p.is_output, p.nodeId, p.portId);
+        }
+        fmt::print("[host] shm-out: {} ({} slots)\n", shmOut, slots);
+    }
+    auto mirrorOutputs = [&]() {
+        if (!shmMirror.hdr) return;
+        ++mirrorSteps;
+        bool begun = false;
+        for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
+            const auto &p = NODEFLOW_PORTS[i];
+            if (!p.is_output || mirrorKind[i] == NODEFLOW_SHM_STRING) continue;
+            const double v = nodeflow_get_output(p.handle, &out, &state);
+            nodeflow_shm_value x;
+            x.bits = 0;
+            if (mirrorKind[i] == NODEFLOW_SHM_INT) x.i = static_cast<int32_t>(v);
+            else if (mirrorKind[i] == NODEFLOW_SHM_DOUBLE) x.d = v;
+            else x.f = static_cast<float>(v);
+            if (mirrorSteps > 1 && x.bits == shmMirror.values[p.handle]) continue;
+            if (!begun) { nodeflow_shm_out_begin(&shmMirror); begun = true; }
+            nodeflow_shm_out_put(&shmMirror, static_cast<uint32_t>(p.handle), x);
+        }
+        if (begun) nodeflow_shm_out_end(&shmMirror, mirrorSteps);
+    };
+    // Step the graph and publish the mirror; callers hold hostMutex
+    auto step = [&]() {
+        nodeflow_step(&in, &out, &state);
+        mirrorOutputs();
+    };
+
     // Optional WebSocket server for schema/snapshots (compare with runtime)
     using WsServer = SimpleWeb::SocketServer<SimpleWeb::WS>;
     std::unique_ptr<WsServer> wsServer;
@@ -253,33 +384,68 @@ int main(int argc, char** argv) {
     std::unordered_map<std::string, std::string> pendingDelta;
     auto lastFlush = std::chrono::steady_clock::now();
     auto lastActivity = std::chrono::steady_clock::now();
-    std::function<std::string()> buildSnapshot;
-    std::function<std::string()> buildDelta;
     std::string wsRegex; // compiled regex key used in endpoint map
+    std::function<NodeFlow::Wire::Message()> buildSnapshot;
+    std::function<NodeFlow::Wire::Message()> buildDelta;
+    // Per-connection wire format ({"type":"subscribe","format":"binary"});
+    // the counts let builders skip a format no client uses
+    std::mutex wsClientsMutex;
+    std::unordered_map<const void*, bool> wsBinaryByConn;
+    std::atomic<int> wsTextClients{0}, wsBinaryClients{0};
+    std::atomic<unsigned long long> wireSeq{0};
+    auto wantBinary = [&](){ return wsBinaryClients > 0; };
+    auto wantText = [&](){ return wsBinaryClients == 0 || wsTextClients > 0; };
+    // Text clients get msg.text, binary clients msg.binary; an empty part is skipped
+    auto broadcastWire = [&](const NodeFlow::Wire::Message &msg) {
+        if (!wsServer || msg.empty()) return;
+        auto it = wsServer->endpoint.find(wsRegex);
+        if (it == wsServer->endpoint.end()) return;
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &c : it->second.get_connections()) {
+            auto itc = wsBinaryByConn.find(c.get());
+            const bool binary = itc != wsBinaryByConn.end() && itc->second;
+            if (binary && !msg.binary.empty()) c->send(msg.binary, nullptr, NodeFlow::Wire::kBinaryOpcode);
+            else if (!binary && !msg.text.empty()) c->send(msg.text);
+        }
+    };
+    // Publish a snapshot: remember the text form and send it to every client
+    auto publishSnapshot = [&](const NodeFlow::Wire::Message &snap) {
+        if (!snap.text.empty()) {
+            std::lock_guard<std::mutex> lock(wsMutex);
+            latestJson = snap.text;
+        }
+        broadcastWire(snap);
+    };
     // Expose input field lookup beyond the WS init block so buildSnapshot remains valid
     std::unordered_map<std::string, std::pair<size_t,const char*>> inputLookup;
     // Track last-sent output values for delta emission
     std::unordered_map<int,double> lastOutByHandle;
+    // --spin: WS sets bump inputSeq (after writing `in` under hostMutex) and
+    // the step loop steps when it moves; inputStampNs is the oldest unstepped arrival
+    std::atomic<unsigned long long> inputSeq{0};
+    std::atomic<long long> inputStampNs{0};
+    LatencyHistogram latency;
     // Timing metadata
     using Steady = std::chrono::steady_clock;
     using Sys = std::chrono::system_clock;
     auto processStartSteady = Steady::now();
-    unsigned long long msgSeq = 0;
-    double lastDtMsObserved = 0.0;
+    // Written by the stepping thread, read by WS/publisher threads in buildT
+    std::atomic<unsigned long long> msgSeq{0};
+    std::atomic<double> lastDtMsObserved{0.0};
     auto buildT = [&](){
         if (!wsIncludeTime) return std::string();
         auto nowSteady = Steady::now();
         auto nowSys = Sys::now();
         auto wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(nowSys.time_since_epoch()).count();
         auto monoNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nowSteady - processStartSteady).count();
-        ++msgSeq;
+        const unsigned long long seq = msgSeq.fetch_add(1, std::memory_order_relaxed) + 1;
         std::string t = ",\"t\":{\"wall_ms\":" + std::to_string((long long)wallMs)
                         + ",\"mono_ns\":" + std::to_string((long long)monoNs)
-                        + ",\"dt_ms\":" + fmt::format("{:.3f}", lastDtMsObserved)
+                        + ",\"dt_ms\":" + fmt::format("{:.3f}", lastDtMsObserved.load(std::memory_order_relaxed))
                         + ",\"clock\":\"" + clockType + "\""
                         + ",\"time_scale\":" + fmt::format("{:.3f}", timeScale)
                         + ",\"rate_hz\":" + std::to_string(fixedRateHz)
-                        + ",\"seq\":" + std::to_string((long long)msgSeq) + "}";
+                        + ",\"seq\":" + std::to_string((long long)seq) + "}";
         return t;
     };
     if (wsEnable) {
@@ -312,8 +478,13 @@ int main(int argc, char** argv) {
                 const auto &p = NODEFLOW_PORTS[i];
                 if (p.is_output) ++outCount[p.nodeId];
             }
-            std::string js = "{\"type\":\"snapshot\"";
-            js += buildT();
+            // The host has no eval generation; binary frames carry 0
+            const bool text = wantText(), binary = wantBinary();
+            NodeFlow::Wire::Message msg;
+            NodeFlow::Wire::FrameWriter w;
+            if (binary) w.begin(NodeFlow::Wire::Kind::Snapshot, ++wireSeq, 0);
+            std::string js;
+            if (text) { js = "{\"type\":\"snapshot\""; js += buildT(); }
             std::lock_guard<std::mutex> lock(hostMutex);
             for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
                 const auto &p = NODEFLOW_PORTS[i];
@@ -330,14 +501,20 @@ int main(int argc, char** argv) {
                 } else {
                     v = nodeflow_get_output(p.handle, &out, &state);
                 }
+                if (binary) w.addNumber(static_cast<std::uint32_t>(p.handle), NodeFlow::Wire::tagForDtype(p.dtype), v);
+                if (!text) continue;
                 js += ",\""; js += p.nodeId; js += ":"; js += p.portId; js += "\":";
                 js += jsonNumberForDtype(p.dtype, v, 3);
             }
-            js += "}\n";
-            return js;
+            if (text) { js += "}\n"; msg.text = std::move(js); }
+            if (binary) msg.binary = w.finish();
+            return msg;
         };
         buildDelta = [&](){
-            // Builds {"type":"delta", "node:port": value, ...} only for changed outputs
+            // Builds {"type":"delta", "node:port": value, ...} (and/or a binary
+            // delta frame) only for changed outputs
+            const bool text = wantText(), binary = wantBinary();
+            NodeFlow::Wire::FrameWriter w;
             std::string js;
             int changed = 0;
             {
@@ -360,16 +537,25 @@ int main(int argc, char** argv) {
                     auto itPrev = lastOutByHandle.find(p.handle);
                     bool isChanged = (itPrev == lastOutByHandle.end()) || (std::abs(itPrev->second - v) > 1e-9);
                     if (isChanged) {
-                        if (changed == 0) { js = "{\"type\":\"delta\""; js += buildT(); }
-                        js += ",\""; js += p.nodeId; js += ":"; js += p.portId; js += "\":";
-                        js += jsonNumberForDtype(p.dtype, v, 3);
+                        if (text) {
+                            if (changed == 0) { js = "{\"type\":\"delta\""; js += buildT(); }
+                            js += ",\""; js += p.nodeId; js += ":"; js += p.portId; js += "\":";
+                            js += jsonNumberForDtype(p.dtype, v, 3);
+                        }
+                        if (binary) {
+                            if (changed == 0) w.begin(NodeFlow::Wire::Kind::Delta, ++wireSeq, 0);
+                            w.addNumber(static_cast<std::uint32_t>(p.handle), NodeFlow::Wire::tagForDtype(p.dtype), v);
+                        }
                         ++changed;
                         lastOutByHandle[p.handle] = v;
                     }
                 }
             }
-            if (changed > 0) { js += "}\n"; return js; }
-            return std::string{};
+            NodeFlow::Wire::Message msg;
+            if (changed == 0) return msg;
+            if (text) { js += "}\n"; msg.text = std::move(js); }
+            if (binary) msg.binary = w.finish();
+            return msg;
         };
         auto has = [&](const std::string &data, const char* key){ return data.find(key) != std::string::npos; };
         auto getStr = [&](const std::string &data, const char* key)->std::string{
@@ -422,10 +608,16 @@ int main(int argc, char** argv) {
                             setInputByNode(node, value);
                         }
                     }
-                    // Recompute immediately for instant feedback only if not paused
-                    {
+                    if (spin) {
+                        // The spinning step loop picks this up; keep the first
+                        // unconsumed arrival time for latency
+                        long long expected = 0;
+                        inputStampNs.compare_exchange_strong(expected, std::chrono::duration_cast<std::chrono::nanoseconds>(Steady::now().time_since_epoch()).count());
+                        inputSeq.fetch_add(1, std::memory_order_release);
+                    } else {
+                        // Recompute immediately for instant feedback only if not paused
                         std::lock_guard<std::mutex> lock(hostMutex);
-                        if (!paused) nodeflow_step(&in, &out, &state);
+                        if (!paused) step();
                     }
                     try { conn->send("{\"ok\":true}\n"); } catch(...) {}
                     // Immediate fast delta on set
@@ -441,18 +633,25 @@ int main(int argc, char** argv) {
                             }
                         }
                         // Prefer canonical nodeId:portId when possible
+                        int outHandle = -1;
                         if (!key.empty()) {
                             for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
                                 const auto &p = NODEFLOW_PORTS[i];
-                                if (p.is_output && p.nodeId == key) { dtype = p.dtype; key = std::string(p.nodeId) + ":" + p.portId; break; }
+                                if (p.is_output && p.nodeId == key) { dtype = p.dtype; key = std::string(p.nodeId) + ":" + p.portId; outHandle = p.handle; break; }
                             }
                         }
-                        std::string val = jsonNumberForDtype(dtype, value, 3);
-                        std::string delta = std::string("{\"type\":\"delta\",\"") + key + "\":" + val + "}\n";
-                        auto it = wsServer->endpoint.find(wsRegex);
-                        if (it != wsServer->endpoint.end()) {
-                            for (auto &c : it->second.get_connections()) c->send(delta);
+                        NodeFlow::Wire::Message delta;
+                        if (wsTextClients > 0) {
+                            std::string val = jsonNumberForDtype(dtype, value, 3);
+                            delta.text = std::string("{\"type\":\"delta\",\"") + key + "\":" + val + "}\n";
                         }
+                        if (wsBinaryClients > 0 && outHandle >= 0) {
+                            NodeFlow::Wire::FrameWriter w;
+                            w.begin(NodeFlow::Wire::Kind::Delta, ++wireSeq, 0);
+                            w.addNumber(static_cast<std::uint32_t>(outHandle), NodeFlow::Wire::tagForDtype(dtype), value);
+                            delta.binary = w.finish();
+                        }
+                        broadcastWire(delta);
                         // Update lastOutByHandle so the next aggregated buildDelta won't resend the same change
                         {
                             auto pos = key.find(':');
@@ -465,15 +664,7 @@ int main(int argc, char** argv) {
                         }
                         lastActivity = std::chrono::steady_clock::now();
                     } else if (buildSnapshot && wsServer) {
-                        std::string snap = buildSnapshot();
-                        {
-                            std::lock_guard<std::mutex> lock(wsMutex);
-                            latestJson = snap;
-                        }
-                        auto it = wsServer->endpoint.find(wsRegex);
-                        if (it != wsServer->endpoint.end()) {
-                            for (auto &c : it->second.get_connections()) c->send(snap);
-                        }
+                        publishSnapshot(buildSnapshot());
                         lastActivity = std::chrono::steady_clock::now();
                     }
                 } else if (type == "control") {
@@ -481,8 +672,8 @@ int main(int argc, char** argv) {
                     if (cmd == "pause") { paused = true; try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
                     else if (cmd == "resume") { paused = false; try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
                     else if (cmd == "reset") { std::lock_guard<std::mutex> lock(hostMutex); nodeflow_reset(&state); std::memset(&out, 0, sizeof(out)); lastOutByHandle.clear(); try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
-                    else if (cmd == "step_eval") { std::lock_guard<std::mutex> lock(hostMutex); nodeflow_step(&in, &out, &state); try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
-                    else if (cmd == "step_tick") { double dt = getNum(data, "dt_ms"); if (dt < 0) dt = 0.0; { std::lock_guard<std::mutex> lock(hostMutex); nodeflow_tick(dt, &in, &out, &state); nodeflow_step(&in, &out, &state);} try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
+                    else if (cmd == "step_eval") { std::lock_guard<std::mutex> lock(hostMutex); step(); try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
+                    else if (cmd == "step_tick") { double dt = getNum(data, "dt_ms"); if (dt < 0) dt = 0.0; { std::lock_guard<std::mutex> lock(hostMutex); nodeflow_tick(dt, &in, &out, &state); step();} try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
                     else if (cmd == "set_rate") { int hz = (int)getNum(data, "hz"); fixedRateHz = std::max(0, hz); try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
                     else if (cmd == "set_clock") { auto c = getStr(data, "clock"); if (c=="wall"||c=="virtual") { clockType=c; try { conn->send("{\"ok\":true}\n"); } catch(...) {} } else try { conn->send("{\"ok\":false}\n"); } catch(...) {} }
                     else if (cmd == "set_time_scale") { double sc = getNum(data, "scale"); if (sc<0) sc=0; timeScale = sc; try { conn->send("{\"ok\":true}\n"); } catch(...) {} }
@@ -495,7 +686,24 @@ int main(int argc, char** argv) {
                         try { conn->send(s); } catch(...) {}
                     } else { try { conn->send("{\"ok\":false}\n"); } catch(...) {} }
                 } else if (type == "subscribe") {
-                    try { conn->send("{\"ok\":true}\n"); } catch(...) {}
+                    // Optional "format": "json" (default) or "binary" (see NodeFlowWire.hpp)
+                    auto format = getStr(data, "format");
+                    if (!format.empty() && format != "json" && format != "binary") {
+                        try { conn->send("{\"ok\":false,\"err\":\"unknown format\"}\n"); } catch(...) {}
+                        return;
+                    }
+                    if (!format.empty()) {
+                        const bool binary = format == "binary";
+                        std::lock_guard<std::mutex> lock(wsClientsMutex);
+                        bool &cur = wsBinaryByConn[conn.get()];
+                        if (cur != binary) {
+                            if (binary) { --wsTextClients; ++wsBinaryClients; } else { --wsBinaryClients; ++wsTextClients; }
+                            cur = binary;
+                        }
+                    }
+                    try { conn->send(format == "binary" ? "{\"ok\":true,\"format\":\"binary\"}\n" : "{\"ok\":true,\"format\":\"json\"}\n"); } catch(...) {}
+                    // Baseline in the new format; deltas follow
+                    if (format == "binary") { try { conn->send(buildSnapshot().binary, nullptr, NodeFlow::Wire::kBinaryOpcode); } catch(...) {} }
                 } else {
                     try { conn->send("{\"ok\":false}\n"); } catch(...) {}
                 }
@@ -504,20 +712,32 @@ int main(int argc, char** argv) {
             }
         };
         ep.on_open = [&](auto conn){
+            {
+                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                if (wsBinaryByConn.emplace(conn.get(), false).second) ++wsTextClients;
+            }
             try { conn->send(buildSchema()); } catch(...) {}
             {
                 std::lock_guard<std::mutex> lock(wsMutex);
                 {
                     std::lock_guard<std::mutex> lock2(hostMutex);
-                    nodeflow_step(&in, &out, &state);
+                    step();
                 }
-                std::string snap = buildSnapshot();
-                latestJson = snap;
-                conn->send(snap);
+                auto snap = buildSnapshot();
+                latestJson = snap.text;
+                conn->send(snap.text);
             }
             fmt::print("[host] ws client connected\n");
         };
-        ep.on_close = [&](auto, int, const std::string&){ fmt::print("[host] ws client disconnected\n"); };
+        auto forgetClient = [&](const void* c) {
+            std::lock_guard<std::mutex> lock(wsClientsMutex);
+            auto it = wsBinaryByConn.find(c);
+            if (it == wsBinaryByConn.end()) return;
+            if (it->second) --wsBinaryClients; else --wsTextClients;
+            wsBinaryByConn.erase(it);
+        };
+        ep.on_close = [&, forgetClient](auto conn, int, const std::string&){ forgetClient(conn.get()); fmt::print("[host] ws client disconnected\n"); };
+        ep.on_error = [&, forgetClient](auto conn, const SimpleWeb::error_code&){ forgetClient(conn.get()); };
         wsThread = std::thread([&]{
             try {
                 fmt::print("[host] ws listening on {}{}\n", wsPort, wsPath);
@@ -530,7 +750,83 @@ int main(int argc, char** argv) {
         });
     }
 
-    if (rateHz > 0 && durationSec > 0) {
+    if (spin) {
+        // Busy-poll: this thread only ticks and steps. Snapshots, deltas and
+        // perf lines are built on a separate thread kept off the spin core.
+        using namespace std::chrono;
+        std::atomic<bool> spinning{true};
+        std::atomic<unsigned long long> evalCountSpin{0}, evalNsAccumSpin{0}, evalNsMaxSpin{0};
+        std::thread publisher([&] {
+            FILE* fp = perfOut.empty() ? nullptr : std::fopen(perfOut.c_str(), "w");
+            auto lastPerfTs = steady_clock::now();
+            auto lastSnapTs = lastPerfTs;
+            while (spinning) {
+                std::this_thread::sleep_for(milliseconds(wsDeltaRateHz > 0 ? std::max(1, 1000 / wsDeltaRateHz) : 1));
+                if (wsServer && buildSnapshot && steady_clock::now() - lastSnapTs >= milliseconds(100)) {
+                    publishSnapshot(buildSnapshot());
+                    lastSnapTs = steady_clock::now();
+                }
+                if (wsServer && buildDelta) {
+                    broadcastWire(buildDelta());
+                }
+                if (fp && duration_cast<milliseconds>(steady_clock::now() - lastPerfTs).count() >= perfIntervalMs) {
+                    const auto h = latency.take();
+                    unsigned long long samples = 0;
+                    for (auto c : h) samples += c;
+                    std::fprintf(fp, "{\"type\":\"perf\",\"mode\":\"spin\",\"evalCount\":%llu,\"evalTimeNsAccum\":%llu,\"evalTimeNsMax\":%llu,\"latencySamples\":%llu,\"latencyP50Ns\":%llu,\"latencyP90Ns\":%llu,\"latencyP99Ns\":%llu,\"latencyP999Ns\":%llu,\"latencyMaxNs\":%llu}\n",
+                                 evalCountSpin.exchange(0), evalNsAccumSpin.exchange(0), evalNsMaxSpin.exchange(0), samples,
+                                 LatencyHistogram::percentile(h, 0.50), LatencyHistogram::percentile(h, 0.90),
+                                 LatencyHistogram::percentile(h, 0.99), LatencyHistogram::percentile(h, 0.999),
+                                 LatencyHistogram::percentile(h, 1.0));
+                    std::fflush(fp);
+                    lastPerfTs = steady_clock::now();
+                }
+            }
+            if (fp) std::fclose(fp);
+        });
+        if (spinCore >= 0) {
+            if (!pinCurrentThread(spinCore)) fmt::print("[host] spin: could not pin to core {}\n", spinCore);
+            keepThreadOffCore(publisher, spinCore);
+            if (wsThread.joinable()) keepThreadOffCore(wsThread, spinCore);
+        }
+        const auto tickPeriod = duration_cast<steady_clock::duration>(duration<double, std::milli>(1000.0 / (rateHz > 0 ? rateHz : 1000)));
+        const auto endAt = (durationSec > 0) ? steady_clock::now() + seconds(durationSec) : steady_clock::time_point::max();
+        auto lastTs = steady_clock::now();
+        auto nextTick = lastTs + tickPeriod;
+        unsigned long long seenSeq = inputSeq.load(std::memory_order_acquire);
+        while (steady_clock::now() < endAt) {
+            const auto nowTs = steady_clock::now();
+            const unsigned long long seq = inputSeq.load(std::memory_order_acquire);
+            const bool arrived = seq != seenSeq;
+            const bool tickDue = nowTs >= nextTick;
+            if (!arrived && !tickDue) { cpuRelax(); continue; }
+            seenSeq = seq;
+            const long long stamp = arrived ? inputStampNs.exchange(0) : 0;
+            {
+                std::lock_guard<std::mutex> lock(hostMutex);
+                if (!paused) {
+                    if (tickDue) {
+                        double dtMs = duration<double, std::milli>(nowTs - lastTs).count();
+                        if (clockType == "virtual") dtMs = (fixedRateHz > 0 ? 1000.0 / std::max(1, fixedRateHz) : 16.667);
+                        dtMs *= timeScale;
+                        lastTs = nowTs;
+                        nextTick = nowTs + tickPeriod;
+                        lastDtMsObserved.store(dtMs, std::memory_order_relaxed);
+                        if (dtMs > 0.0) nodeflow_tick(dtMs, &in, &out, &state);
+                    }
+                    step();
+                }
+            }
+            const auto t1 = steady_clock::now();
+            const auto ns = (unsigned long long)duration_cast<nanoseconds>(t1 - nowTs).count();
+            evalCountSpin.fetch_add(1, std::memory_order_relaxed);
+            evalNsAccumSpin.fetch_add(ns, std::memory_order_relaxed);
+            if (ns > evalNsMaxSpin.load(std::memory_order_relaxed)) evalNsMaxSpin.store(ns, std::memory_order_relaxed);
+            if (stamp > 0) latency.record((unsigned long long)(duration_cast<nanoseconds>(t1.time_since_epoch()).count() - stamp));
+        }
+        spinning = false;
+        publisher.join();
+    } else if (rateHz > 0 && durationSec > 0) {
         using namespace std::chrono;
         const auto tick = milliseconds(1000 / rateHz);
         const auto endAt = steady_clock::now() + seconds(durationSec);
@@ -543,9 +839,9 @@ int main(int argc, char** argv) {
                 if (clockType == "virtual") { dtMs = (fixedRateHz > 0 ? 1000.0 / std::max(1, fixedRateHz) : 16.667); }
                 dtMs *= timeScale;
                 lastTs = nowTs;
-                lastDtMsObserved = dtMs;
+                lastDtMsObserved.store(dtMs, std::memory_order_relaxed);
                 if (!paused && dtMs > 0.0) nodeflow_tick(dtMs, &in, &out, &state);
-                if (!paused) nodeflow_step(&in, &out, &state);
+                if (!paused) step();
             }
             // Print all outputs generically
             for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
@@ -555,22 +851,14 @@ int main(int argc, char** argv) {
                 fmt::print("{}:{}={:.6f}\n", p.nodeId, p.portId, v);
             }
             if (wsEnable && wsServer && buildSnapshot) {
-                std::string snap = buildSnapshot();
-                {
-                    std::lock_guard<std::mutex> lock(wsMutex);
-                    latestJson = snap;
-                }
-                auto it = wsServer->endpoint.find(wsRegex);
-                if (it != wsServer->endpoint.end()) {
-                    for (auto &c : it->second.get_connections()) c->send(snap);
-                }
+                publishSnapshot(buildSnapshot());
             }
             std::this_thread::sleep_for(tick);
         }
     } else {
         {
             std::lock_guard<std::mutex> lock(hostMutex);
-            nodeflow_step(&in, &out, &state);
+            step();
         }
         for (int i = 0; i < NODEFLOW_NUM_PORTS; ++i) {
             const auto &p = NODEFLOW_PORTS[i];
@@ -591,27 +879,13 @@ int main(int argc, char** argv) {
                     if (clockType == "virtual") { dtMs = (fixedRateHz > 0 ? 1000.0 / std::max(1, fixedRateHz) : 16.667); }
                     dtMs *= timeScale;
                     lastTs = nowTs;
-                    lastDtMsObserved = dtMs;
+                    lastDtMsObserved.store(dtMs, std::memory_order_relaxed);
                     if (!paused && dtMs > 0.0) nodeflow_tick(dtMs, &in, &out, &state);
-                    if (!paused) nodeflow_step(&in, &out, &state);
-                }
-                std::string snap = buildSnapshot();
-                {
-                    std::lock_guard<std::mutex> lock(wsMutex);
-                    latestJson = snap;
-                }
-                auto it = wsServer->endpoint.find(wsRegex);
-                if (it != wsServer->endpoint.end()) {
-                    for (auto &c : it->second.get_connections()) c->send(snap);
+                    if (!paused) step();
                 }
+                publishSnapshot(buildSnapshot());
                 if (buildDelta) {
-                    std::string delta = buildDelta();
-                    if (!delta.empty()) {
-                        auto it2 = wsServer->endpoint.find(wsRegex);
-                        if (it2 != wsServer->endpoint.end()) {
-                            for (auto &c : it2->second.get_connections()) c->send(delta);
-                        }
-                    }
+                    broadcastWire(buildDelta());
                 }
                 std::this_thread::sleep_for(100ms);
             }
@@ -623,6 +897,7 @@ int main(int argc, char** argv) {
         try { wsServer->stop(); } catch(...) {}
         if (wsThread.joinable()) wsThread.join();
     }
+    if (shmMirror.hdr) nodeflow_shm_out_destroy(&shmMirror, shmOut.c_str());
     return 0;
 }
 
@@ -0,0 +1,68 @@
+/* shm_reader.c
+ *
+ * Minimal --shm-out consumer: maps the runtime's output mirror read-only,
+ * spins on its seqlock word and prints the ports that changed in each new
+ * generation with the publish-to-read delay. Skipped generations (the reader
+ * was slower than the engine) are reported; their changes are recovered by
+ * diffing against the previous copy.
+ *
+ *   NodeFlowCore --flow flows/demo.json --shm-out /nodeflow-out &
+ *   shm_reader /nodeflow-out
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "../nodeflow_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_value(const nodeflow_shm_out_desc* d, uint64_t bits) {
+    nodeflow_shm_value v;
+    v.bits = bits;
+    if (d->dtype == NODEFLOW_SHM_INT) printf(" %s=%d", d->name, v.i);
+    else if (d->dtype == NODEFLOW_SHM_DOUBLE) printf(" %s=%g", d->name, v.d);
+    else printf(" %s=%g", d->name, (double)v.f);
+}
+
+int main(int argc, char** argv) {
+    nodeflow_shm_out m;
+    uint64_t *values, *prev, *changed;
+    uint64_t seen = 0, lastGen = 0;
+    uint32_t h, slots;
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s /name\n", argv[0]);
+        return 2;
+    }
+    if (nodeflow_shm_out_open(&m, argv[1]) != 0) {
+        fprintf(stderr, "%s: no NodeFlow output mirror\n", argv[1]);
+        return 1;
+    }
+    slots = m.hdr->slots;
+    values = (uint64_t*)calloc(slots ? slots : 1, sizeof(uint64_t));
+    prev = (uint64_t*)calloc(slots ? slots : 1, sizeof(uint64_t));
+    changed = (uint64_t*)calloc(m.hdr->bitmap_words ? m.hdr->bitmap_words : 1, sizeof(uint64_t));
+    for (;;) {
+        uint64_t gen, publishedNs;
+        if (nodeflow_shm_out_seq(&m) == seen) continue; /* memory-speed poll */
+        nodeflow_shm_out_read(&m, values, changed, &gen, &seen);
+        publishedNs = __atomic_load_n(&m.hdr->timestamp_ns, __ATOMIC_RELAXED); /* may be one publish newer */
+        if (gen == lastGen) continue;
+        printf("gen=%llu delayNs=%lld", (unsigned long long)gen, (long long)(nodeflow_shm_now_ns() - publishedNs));
+        if (lastGen != 0 && gen != lastGen + 1) {
+            /* Missed bitmaps: anything that differs from our last copy changed */
+            printf(" skipped=%llu", (unsigned long long)(gen - lastGen - 1));
+            for (h = 0; h < slots; ++h) {
+                if (values[h] != prev[h]) changed[h / 64] |= (uint64_t)1 << (h % 64);
+            }
+        }
+        for (h = 0; h < slots; ++h) {
+            if (m.descs[h].dtype == 0xFF || m.descs[h].dtype == NODEFLOW_SHM_STRING) continue;
+            if (changed[h / 64] & ((uint64_t)1 << (h % 64))) print_value(&m.descs[h], values[h]);
+        }
+        printf("\n");
+        fflush(stdout);
+        memcpy(prev, values, slots * sizeof(uint64_t));
+        lastGen = gen;
+    }
+}
@@ -6,17 +6,41 @@
 // - Broadcasts generic snapshots and per-port deltas
 // - Accepts control messages (set/config/reload)
 #include "NodeFlowCore.hpp"
+#include "NodeFlowBatch.hpp"
+#include "NodeFlowWire.hpp"
+#include "NodeFlowShm.hpp"
+#include "NodeFlowDelta.hpp"
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <random>
 #include <iostream>
 #include <CLI/CLI.hpp>
 #include <fmt/core.h>
 #include "third_party/Simple-WebSocket-Server/server_ws.hpp"
+#include "third_party/Simple-WebSocket-Server/client_ws.hpp"
 #include <mutex>
+#include <algorithm>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <new>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using NodeFlow::PendingDelta;
+using NodeFlow::appendJsonString;
 
 // Type-aware JSON number formatting for core runtime
 static inline std::string jsonNumberForDtype(const std::string &dtype, double v, int floatPrecision = 3, bool trimZeros = true) {
@@ -29,6 +53,228 @@ static inline std::string jsonNumberForDtype(const std::string &dtype, double v,
     return fmt::format("{:.{}f}", v, floatPrecision);
 }
 
+// JSON text of a port value (numbers via jsonNumberForDtype, strings escaped)
+static std::string valueToJson(const NodeFlow::Value &v) {
+    if (std::holds_alternative<float>(v)) return jsonNumberForDtype("float", (double)std::get<float>(v), 3);
+    if (std::holds_alternative<double>(v)) return jsonNumberForDtype("double", (double)std::get<double>(v), 3);
+    if (std::holds_alternative<int>(v)) return jsonNumberForDtype("int", (double)std::get<int>(v), 3);
+    if (std::holds_alternative<std::string>(v)) {
+        const auto &s = std::get<std::string>(v);
+        std::string esc; esc.reserve(s.size()+2);
+        appendJsonString(esc, s);
+        return esc;
+    }
+    return "null";
+}
+
+// Shell-style glob: '*' any run, '?' any one character
+static bool globMatch(const std::string &pat, const std::string &text) {
+    size_t p = 0, t = 0, star = std::string::npos, mark = 0;
+    while (t < text.size()) {
+        if (p < pat.size() && (pat[p] == '?' || pat[p] == text[t])) { ++p; ++t; }
+        else if (p < pat.size() && pat[p] == '*') { star = p++; mark = t; }
+        else if (star != std::string::npos) { p = star + 1; t = ++mark; }
+        else return false;
+    }
+    while (p < pat.size() && pat[p] == '*') ++p;
+    return p == pat.size();
+}
+
+// Heap allocation counter behind --bench-ws-delta; counts only while enabled.
+// It replaces the global operator new, so it is only compiled into bench
+// builds (-DNODEFLOW_COUNT_ALLOCS=ON); otherwise gAllocs stays 0.
+#ifndef NODEFLOW_COUNT_ALLOCS
+#define NODEFLOW_COUNT_ALLOCS 0
+#endif
+static std::atomic<bool> gCountAllocs{false};
+static std::atomic<unsigned long long> gAllocs{0};
+
+#if NODEFLOW_COUNT_ALLOCS
+void* operator new(std::size_t n) {
+    if (gCountAllocs.load(std::memory_order_relaxed)) gAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+// Output mirror for --shm-out (layout in nodeflow_shm.h): a seqlocked copy of
+// every numeric output indexed by handle, refreshed after each eval from the
+// engine's change log, so one publish costs O(changes). Engine thread only,
+// under the engine lock. Slots are sized at startup with some headroom; ports
+// added later by edits past that are not mirrored.
+class ShmOutputMirror {
+public:
+    ShmOutputMirror() = default;
+    ShmOutputMirror(const ShmOutputMirror&) = delete;
+    ShmOutputMirror& operator=(const ShmOutputMirror&) = delete;
+    ~ShmOutputMirror() { if (seg.hdr) nodeflow_shm_out_destroy(&seg, segName.c_str()); }
+
+    bool create(const std::string &name, size_t ports) {
+        segName = name;
+        const uint32_t slots = static_cast<uint32_t>((ports + 64) / 64 * 64);
+        return nodeflow_shm_out_create(&seg, name.c_str(), slots) == 0;
+    }
+    size_t slots() const { return seg.hdr ? seg.hdr->slots : 0; }
+    const std::string& name() const { return segName; }
+
+    // Publish the outputs that changed since the last call (all of them after
+    // a load or edit, which also re-describes the slots). Sets made between
+    // evals are stamped with the generation of the eval before them, so the
+    // watermark trails by one and values already mirrored are skipped.
+    void publish(const NodeFlow::FlowEngine &engine) {
+        const auto snap = engine.getSnapshot();
+        if (!snap) return;
+        const auto &descs = snap->descs;
+        const NodeFlow::Generation gen = engine.currentEvalGeneration();
+        bool begun = false;
+        auto put = [&](NodeFlow::PortHandle h) {
+            if (static_cast<size_t>(h) >= kind.size() || kind[h] == NODEFLOW_SHM_STRING) return;
+            const NodeFlow::Value v = engine.readPort(h);
+            nodeflow_shm_value x;
+            x.bits = 0;
+            if (const int *i = std::get_if<int>(&v)) x.i = *i;
+            else if (const float *f = std::get_if<float>(&v)) x.f = *f;
+            else if (const double *d = std::get_if<double>(&v)) x.d = *d;
+            if (mirrored[h] && x.bits == seg.values[h]) return;
+            if (!begun) { nodeflow_shm_out_begin(&seg); begun = true; }
+            nodeflow_shm_out_put(&seg, static_cast<uint32_t>(h), x);
+            mirrored[h] = 1;
+        };
+        if (descs != layoutDescs) {
+            nodeflow_shm_out_begin(&seg); // readers must not see half-renamed slots
+            begun = true;
+            relayout(*descs);
+            layoutDescs = descs;
+            for (const auto &d : *descs) if (!d.removed && d.direction == "output") put(d.handle);
+        } else {
+            engine.forEachPortChangedSince(since, put);
+        }
+        if (begun) nodeflow_shm_out_end(&seg, gen);
+        since = gen > 0 ? gen - 1 : 0;
+    }
+
+private:
+    void relayout(const std::vector<NodeFlow::PortDesc> &descs) {
+        const size_t n = std::min(descs.size(), slots());
+        if (descs.size() > n) fmt::print("shm-out: {} of {} ports fit in {}, the rest are not mirrored\n", n, descs.size(), segName);
+        kind.assign(n, NODEFLOW_SHM_STRING);
+        mirrored.assign(n, 0);
+        for (uint32_t h = 0; h < seg.hdr->slots; ++h) seg.descs[h].dtype = 0xFF;
+        for (size_t h = 0; h < n; ++h) {
+            const auto &d = descs[h];
+            if (d.removed) continue;
+            kind[h] = static_cast<uint32_t>(NodeFlow::dtypeFromString(d.dataType)); // NODEFLOW_SHM_* follow DType
+            nodeflow_shm_out_describe(&seg, static_cast<uint32_t>(h), kind[h], d.direction == "output", d.nodeId.c_str(), d.portId.c_str());
+        }
+    }
+
+    nodeflow_shm_out seg{};
+    std::string segName;
+    std::shared_ptr<const std::vector<NodeFlow::PortDesc>> layoutDescs;
+    std::vector<uint32_t> kind;    // port handle -> NODEFLOW_SHM_* dtype
+    std::vector<uint8_t> mirrored; // port handle -> value slot written since the layout
+    NodeFlow::Generation since = 0;
+};
+
+// Synthetic wide fan-out graph for scheduler benchmarks: `width` chains of
+// `depth` Add nodes fanning back in to a single sink Add.
+// - dense: one DeviceTrigger feeds every chain, so each trigger change dirties
+//   width * depth + 1 nodes in one wave.
+// - sparse: each chain has its own trigger and chains are summed in groups of
+//   64 before the sink, so a change dirties only depth + 2 nodes of the graph.
+static nlohmann::json makeFanoutFlow(int width, int depth = 1, bool sparse = false) {
+    nlohmann::json flow;
+    flow["nodes"] = nlohmann::json::array();
+    flow["connections"] = nlohmann::json::array();
+    auto addNode = [&](const std::string &id, const char *type, const nlohmann::json &inputs) {
+        nlohmann::json node = {{"id", id}, {"type", type}, {"inputs", inputs}, {"outputs", {{{"id", "out1"}, {"type", "float"}}}}};
+        if (inputs.empty()) node["parameters"] = {{"value", 0.0}};
+        flow["nodes"].push_back(std::move(node));
+    };
+    auto connect = [&](const std::string &from, const std::string &to, const std::string &toPort) {
+        flow["connections"].push_back({{"fromNode", from}, {"fromPort", "out1"}, {"toNode", to}, {"toPort", toPort}});
+    };
+    const nlohmann::json oneInput = {{{"id", "in1"}, {"type", "float"}}};
+    const int groupSize = sparse ? 64 : width;
+    if (!sparse) addNode("src", "DeviceTrigger", nlohmann::json::array());
+    nlohmann::json sinkInputs = nlohmann::json::array();
+    nlohmann::json groupInputs = nlohmann::json::array();
+    std::vector<std::string> groupMembers;
+    for (int i = 0; i < width; ++i) {
+        std::string prev = "src";
+        if (sparse) {
+            prev = fmt::format("src{}", i);
+            addNode(prev, "DeviceTrigger", nlohmann::json::array());
+        }
+        for (int d = 0; d < std::max(depth, 1); ++d) {
+            const std::string id = (d == 0) ? fmt::format("fan{}", i) : fmt::format("fan{}_{}", i, d);
+            addNode(id, "Add", oneInput);
+            connect(prev, id, "in1");
+            prev = id;
+        }
+        groupMembers.push_back(prev);
+        if (static_cast<int>(groupMembers.size()) == groupSize || i + 1 == width) {
+            std::string into = "sink";
+            if (sparse) {
+                into = fmt::format("agg{}", sinkInputs.size());
+                nlohmann::json aggInputs = nlohmann::json::array();
+                for (size_t k = 0; k < groupMembers.size(); ++k) aggInputs.push_back({{"id", fmt::format("in{}", k + 1)}, {"type", "float"}});
+                addNode(into, "Add", aggInputs);
+            }
+            for (size_t k = 0; k < groupMembers.size(); ++k) {
+                const std::string port = fmt::format("in{}", k + 1);
+                if (!sparse) sinkInputs.push_back({{"id", port}, {"type", "float"}});
+                connect(groupMembers[k], into, port);
+            }
+            if (sparse) {
+                const std::string port = fmt::format("in{}", sinkInputs.size() + 1);
+                sinkInputs.push_back({{"id", port}, {"type", "float"}});
+                connect(into, "sink", port);
+            }
+            groupMembers.clear();
+        }
+    }
+    addNode("sink", "Add", sinkInputs);
+    return flow;
+}
+
+// Pin the calling thread to one core (--spin); false where affinity is unsupported
+static bool pinCurrentThread(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+// Let a thread run anywhere except `core`, keeping it off the spinning engine
+static void keepThreadOffCore(std::thread &th, int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    const int n = static_cast<int>(std::thread::hardware_concurrency());
+    for (int c = 0; c < n; ++c) if (c != core) CPU_SET(c, &set);
+    if (CPU_COUNT(&set) > 0) pthread_setaffinity_np(th.native_handle(), sizeof(set), &set);
+#else
+    (void)th; (void)core;
+#endif
+}
+
+// Busy-wait hint for spin loops
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
 // Global state
 std::atomic<bool> running(true);
 
@@ -49,8 +295,29 @@ int main(int argc, char** argv) {
     bool bench = false;            // compute-only benchmark disables WS
     int benchRate = 0;             // Hz feeder
     int benchDuration = 0;         // seconds
+    int benchFanout = 0;           // >0: replace flow with synthetic fan-out graph of this width
+    int benchDepth = 1;            // chain length per fan-out branch
+    bool benchSparse = false;      // one trigger per branch (sparse waves)
+    bool benchExecutors = false;   // compare serial / levels / steal executors
+    int benchInstances = 0;        // >0: compare N FlowEngines vs one BatchFlowEngine of N instances
+    std::string benchScheduler = "bitset"; // bitset|legacy|both
+    bool benchQueue = false;       // feed inputs through the lock-free input queue
+    std::vector<int> benchWsClients; // WS fan-out send cost for these local client counts
+    bool benchWsDelta = false;     // WS delta accumulate/format cost and heap allocations
+    int benchBatch = 0;            // >0: N sets per frame, one by one vs setNodeValues
+    bool benchShmIn = false;       // producer threads -> input queue vs shared-memory ring
+    bool benchShmOut = false;      // set-to-observed latency: --shm-out reader vs WS client
+    int benchShmProducers = 1;     // producer threads for --bench-shm-in
     std::string perfOut;           // NDJSON file
+    int workers = 1;               // >1: parallel execution
+    std::string parallelMode = "steal"; // levels|steal (dirty waves when workers > 1)
     int perfIntervalMs = 1000;     // summary interval
+    int inputQueueSize = 65536;    // input ingestion ring capacity (power of two)
+    bool spin = false;             // busy-poll engine loop (no blocking waits)
+    int spinCore = -1;             // core the spinning engine thread is pinned to (-1 = no pinning)
+    std::string shmIn;             // shared-memory input ring name (e.g. /nodeflow-in); empty = off
+    int shmInCapacity = 65536;     // records in that ring (power of two)
+    std::string shmOut;            // shared-memory output mirror name (e.g. /nodeflow-out); empty = off
     // WS delta aggregation
     int wsDeltaRateHz = 60;        // 0 = immediate
     int wsDeltaMaxBatch = 512;
@@ -59,6 +326,8 @@ int main(int argc, char** argv) {
     bool wsDeltaFast = true;       // send immediate tiny delta on set
     int wsSnapshotIntervalSec = 0; // 0 = no periodic snapshots (only on connect)
     bool wsIncludeTime = false;    // include timing metadata in WS messages
+    int wsClientQueueKb = 1024;    // per-client unsent bytes before it counts as behind
+    int wsClientResyncMs = 2000;   // behind this long: drop its backlog, resync with a snapshot
     // Control/time model
     bool paused = false;
     std::string clockType = "wall"; // "wall" | "virtual"
@@ -76,8 +345,29 @@ int main(int argc, char** argv) {
         app.add_flag("--bench", bench, "Compute-only benchmark (disable WS)");
         app.add_option("--bench-rate", benchRate, "Feeder rate Hz for benchmark");
         app.add_option("--bench-duration", benchDuration, "Benchmark duration seconds");
+        app.add_option("--bench-fanout", benchFanout, "Benchmark a synthetic fan-out graph of N nodes instead of --flow");
+        app.add_option("--bench-depth", benchDepth, "Chain length per branch of the --bench-fanout graph");
+        app.add_flag("--bench-sparse", benchSparse, "Give each --bench-fanout branch its own trigger (sparse waves)");
+        app.add_flag("--bench-executors", benchExecutors, "Compare serial, levels and steal executors (uses --workers)");
+        app.add_option("--bench-instances", benchInstances, "Compare N separate engines vs one batched engine of N instances");
+        app.add_option("--bench-scheduler", benchScheduler, "Ready-set scheduler for benchmark: bitset|legacy|both");
+        app.add_flag("--bench-queue", benchQueue, "Feed benchmark inputs through the input queue instead of setNodeValue");
+        app.add_option("--bench-batch", benchBatch, "Compare N single sets (lock + eval each) vs one setNodeValues batch of N per frame");
+        app.add_flag("--bench-ws-delta", benchWsDelta, "Measure the WS delta path per eval and fail if it allocates in steady state");
+        app.add_flag("--bench-shm-in", benchShmIn, "Drive inputs from producer threads through the input queue, then a --shm-in ring");
+        app.add_option("--bench-shm-producers", benchShmProducers, "Producer threads for --bench-shm-in");
+        app.add_flag("--bench-shm-out", benchShmOut, "Measure set-to-observed latency of a --shm-out reader vs a WS delta client");
+        app.add_option("--bench-ws-clients", benchWsClients, "Measure WS broadcast send CPU for these local client counts (e.g. 1,10,100,1000)")->delimiter(',');
         app.add_option("--perf-out", perfOut, "Write NDJSON perf summaries to file");
         app.add_option("--perf-interval", perfIntervalMs, "Perf summary interval ms");
+        app.add_option("--workers", workers, "Worker threads for parallel execution (1=serial)");
+        app.add_option("--parallel", parallelMode, "Parallel wave executor when --workers > 1: levels|steal");
+        app.add_option("--input-queue", inputQueueSize, "Capacity of the lock-free input queue (excess inputs are dropped)");
+        app.add_flag("--spin", spin, "Busy-poll the input queue and clock on the engine thread; WS work moves to its own thread");
+        app.add_option("--spin-core", spinCore, "Pin the --spin engine thread to this core; other threads avoid it");
+        app.add_option("--shm-in", shmIn, "Create a shared-memory input ring of this name for local producers (nodeflow_shm.h)");
+        app.add_option("--shm-in-capacity", shmInCapacity, "Records in the --shm-in ring (excess pushes are dropped)");
+        app.add_option("--shm-out", shmOut, "Mirror output port values into shared memory of this name after each eval (nodeflow_shm.h)");
         // WS delta aggregation
         app.add_option("--ws-delta-rate-hz", wsDeltaRateHz, "Delta flush rate in Hz (0=immediate)");
         app.add_option("--ws-delta-max-batch", wsDeltaMaxBatch, "Max keys per delta batch");
@@ -87,6 +377,8 @@ int main(int argc, char** argv) {
         app.add_option("--ws-snapshot-interval", wsSnapshotIntervalSec, "Periodic full snapshot interval seconds (0=off)");
         
         app.add_flag("--ws-time", wsIncludeTime, "Include timing metadata in WS messages");
+        app.add_option("--ws-client-queue-kb", wsClientQueueKb, "Unsent KB per client before its deltas are coalesced");
+        app.add_option("--ws-client-resync-ms", wsClientResyncMs, "Resync a client with a snapshot after lagging this long");
         app.add_option("--clock", clockType, "Clock type: wall|virtual");
         app.add_option("--time-scale", timeScale, "Time scale multiplier (0..N)");
         app.add_option("--ws-fixed-rate", fixedRateHz, "Virtual clock fixed step Hz (0=off)");
@@ -100,7 +392,10 @@ int main(int argc, char** argv) {
     }
 
     nlohmann::json json;
-    {
+    if (bench && benchFanout > 0) {
+        json = makeFanoutFlow(benchFanout, benchDepth, benchSparse);
+        flowPath = fmt::format("<fanout:{}>", benchFanout);
+    } else {
         std::ifstream f(flowPath);
         if (f.good()) {
             f >> json;
@@ -118,7 +413,11 @@ int main(int argc, char** argv) {
             }
         }
     }
+    engine.setInputQueueCapacity(static_cast<size_t>(std::max(2, inputQueueSize)));
     engine.loadFromJson(json);
+    engine.setWorkers(workers);
+    engine.setParallelMode(parallelMode == "levels" ? NodeFlow::FlowEngine::ParallelMode::Levels
+                                                    : NodeFlow::FlowEngine::ParallelMode::WorkStealing);
 
     // No random interval parsing here; inputs are driven externally via IPC
 
@@ -148,88 +447,644 @@ int main(int argc, char** argv) {
     // Startup message
     fmt::print("NodeFlowCore started. WS=on, flow='{}'\n", flowPath);
 
+    // Shared-memory ingress (--shm-in): local producers push records the
+    // engine drains with its input queue. The bench makes a private ring.
+    std::unique_ptr<NodeFlow::ShmInputRing> shmRing;
+    if (!shmIn.empty() || (bench && benchShmIn)) {
+        const std::string name = !shmIn.empty() ? shmIn : fmt::format("/nodeflow-bench-{}", static_cast<long>(getpid()));
+        try {
+            shmRing = std::make_unique<NodeFlow::ShmInputRing>(name, static_cast<size_t>(std::max(2, shmInCapacity)));
+        } catch (const std::exception &e) {
+            fmt::print("{}\n", e.what());
+            return 1;
+        }
+        engine.setInputRing(shmRing.get());
+        fmt::print("shm-in: {} ({} records)\n", shmRing->name(), shmRing->capacity());
+    }
+    // Output mirror (--shm-out) for co-located readers; published by the
+    // engine thread after each eval
+    ShmOutputMirror shmMirror;
+    const bool mirrorOn = !shmOut.empty() || (bench && benchShmOut);
+    if (mirrorOn) {
+        const std::string name = !shmOut.empty() ? shmOut : fmt::format("/nodeflow-bench-out-{}", static_cast<long>(getpid()));
+        if (!shmMirror.create(name, engine.getPortDescs().size())) {
+            fmt::print("shm-out: cannot create {}: {}\n", name, std::strerror(errno));
+            return 1;
+        }
+        fmt::print("shm-out: {} ({} slots)\n", shmMirror.name(), shmMirror.slots());
+    }
+
     // Bench compute-only mode: disable WS; feed inputs and measure
-    if (bench) {
+    if (bench && benchWsClients.empty() && !benchShmOut) {
         using clk = std::chrono::steady_clock;
-        auto tLast = clk::now();
-        unsigned long long evalCount = 0, evalNsAccum = 0, evalNsMin = ~0ull, evalNsMax = 0;
-        auto flushPerf = [&](bool force){
-            if (!perfOut.empty()) {
-                static FILE* fp = nullptr;
-                if (!fp) fp = std::fopen(perfOut.c_str(), "w");
-                if (fp) {
-                    auto ps = engine.getAndResetPerfStats();
-                    std::fprintf(fp,
-                        "{\"type\":\"perf\",\"evalCount\":%llu,\"evalTimeNsAccum\":%llu,\"evalTimeNsMin\":%llu,\"evalTimeNsMax\":%llu,\"nodesEvaluated\":%llu,\"dependentsEnqueued\":%llu,\"readyQueueMax\":%llu}\n",
-                        evalCount, evalNsAccum, evalNsMin, evalNsMax,
-                        ps.nodesEvaluated, ps.dependentsEnqueued, ps.readyQueueMax);
-                    if (force) std::fflush(fp);
-                }
-            }
-            evalCount = 0; evalNsAccum = 0; evalNsMin = ~0ull; evalNsMax = 0;
-        };
         using namespace std::chrono;
-        const auto tick = (benchRate > 0) ? milliseconds(1000 / benchRate) : milliseconds(0);
-        const auto endAt = (benchDuration > 0) ? clk::now() + seconds(benchDuration) : time_point<clk>::max();
+        FILE* perfFp = perfOut.empty() ? nullptr : std::fopen(perfOut.c_str(), "w");
         // Choose device triggers (outputs) as inputs; set round-robin
         std::vector<std::string> inputNodes;
         for (const auto &n : engine.getNodeDescs()) if (n.type == "DeviceTrigger") inputNodes.push_back(n.id);
         if (inputNodes.empty()) for (const auto &n : engine.getNodeDescs()) inputNodes.push_back(n.id);
-        size_t rr = 0;
-        while (clk::now() < endAt) {
-            auto t0 = clk::now();
-            if (!inputNodes.empty()) {
-                const auto &node = inputNodes[rr % inputNodes.size()];
-                float oldv = 0.0f;
-                engine.setNodeValue(node, oldv); // ensure exists
-                engine.setNodeValue(node, (rr & 1) ? 1.0f : 0.0f);
-                ++rr;
-            }
-            engine.execute();
-            auto t1 = clk::now();
-            auto ns = (unsigned long long)duration_cast<nanoseconds>(t1 - t0).count();
-            ++evalCount; evalNsAccum += ns; if (ns < evalNsMin) evalNsMin = ns; if (ns > evalNsMax) evalNsMax = ns;
-            if (benchRate > 0 && tick.count() > 0) std::this_thread::sleep_for(tick);
-            if (duration_cast<milliseconds>(clk::now() - tLast).count() >= perfIntervalMs) { flushPerf(true); tLast = clk::now(); }
-        }
-        flushPerf(true);
+        // Queue feeding addresses a node by one of its port handles
+        std::vector<NodeFlow::PortHandle> inputHandles;
+        for (const auto &id : inputNodes) {
+            for (const auto &n : engine.getNodeDescs()) {
+                if (n.id != id) continue;
+                inputHandles.push_back(!n.outputPorts.empty() ? n.outputPorts[0] : !n.inputPorts.empty() ? n.inputPorts[0] : -1);
+                break;
+            }
+        }
+        using Engine = NodeFlow::FlowEngine;
+        // One timed run with the engine's current scheduler/executor; prints a summary line at the end
+        auto runBench = [&](int durationSec) {
+            const char* schedName = (engine.getScheduler() == Engine::Scheduler::LegacyQueue) ? "legacy" : "bitset";
+            const char* execName = (engine.getWorkers() <= 1) ? "serial"
+                                 : (engine.getParallelMode() == Engine::ParallelMode::Levels) ? "levels" : "steal";
+            engine.getAndResetPerfStats();
+            auto tLast = clk::now();
+            unsigned long long evalCount = 0, evalNsAccum = 0, evalNsMin = ~0ull, evalNsMax = 0;
+            unsigned long long totalEvals = 0, totalNs = 0, totalNodes = 0, totalStolen = 0, worstNs = 0;
+            auto flushPerf = [&](bool force){
+                auto ps = engine.getAndResetPerfStats();
+                totalEvals += evalCount; totalNs += evalNsAccum; totalNodes += ps.nodesEvaluated; totalStolen += ps.tasksStolen;
+                if (evalNsMax > worstNs) worstNs = evalNsMax;
+                if (perfFp) {
+                    // Per-level [timeNs, nodes] pairs (parallel mode only)
+                    std::string levels = "[";
+                    for (size_t l = 0; l < ps.levelsUsed; ++l) {
+                        levels += fmt::format("{}[{},{}]", l ? "," : "", ps.levelTimeNsAccum[l], ps.levelNodes[l]);
+                    }
+                    levels += "]";
+                    std::fprintf(perfFp,
+                        "{\"type\":\"perf\",\"scheduler\":\"%s\",\"executor\":\"%s\",\"workers\":%d,\"evalCount\":%llu,\"evalTimeNsAccum\":%llu,\"evalTimeNsMin\":%llu,\"evalTimeNsMax\":%llu,\"nodesEvaluated\":%llu,\"dependentsEnqueued\":%llu,\"readyQueueMax\":%llu,\"tasksStolen\":%llu,\"inputsDrained\":%llu,\"inputsCoalesced\":%llu,\"inputsDropped\":%llu,\"inputQueueDepthMax\":%llu,\"inputLatencyNsAccum\":%llu,\"inputLatencyNsMax\":%llu,\"levels\":%s}\n",
+                        schedName, execName, engine.getWorkers(), evalCount, evalNsAccum, evalNsMin, evalNsMax,
+                        ps.nodesEvaluated, ps.dependentsEnqueued, ps.readyQueueMax, ps.tasksStolen,
+                        ps.inputsDrained, ps.inputsCoalesced, ps.inputsDropped, ps.inputQueueDepthMax,
+                        ps.inputLatencyNsAccum, ps.inputLatencyNsMax, levels.c_str());
+                    if (force) std::fflush(perfFp);
+                }
+                evalCount = 0; evalNsAccum = 0; evalNsMin = ~0ull; evalNsMax = 0;
+            };
+            const auto tick = (benchRate > 0) ? milliseconds(1000 / benchRate) : milliseconds(0);
+            const auto endAt = (durationSec > 0) ? clk::now() + seconds(durationSec) : time_point<clk>::max();
+            size_t rr = 0;
+            while (clk::now() < endAt) {
+                auto t0 = clk::now();
+                if (!inputNodes.empty()) {
+                    // Toggle per visit of this node, so every set is a real change for any input count
+                    const float v = ((rr / inputNodes.size()) & 1) ? 1.0f : 0.0f;
+                    if (benchQueue) {
+                        engine.postInput(inputHandles[rr % inputHandles.size()], v);
+                    } else {
+                        const auto &node = inputNodes[rr % inputNodes.size()];
+                        float oldv = 0.0f;
+                        engine.setNodeValue(node, oldv); // ensure exists
+                        engine.setNodeValue(node, v);
+                    }
+                    ++rr;
+                }
+                engine.execute();
+                auto t1 = clk::now();
+                auto ns = (unsigned long long)duration_cast<nanoseconds>(t1 - t0).count();
+                ++evalCount; evalNsAccum += ns; if (ns < evalNsMin) evalNsMin = ns; if (ns > evalNsMax) evalNsMax = ns;
+                if (benchRate > 0 && tick.count() > 0) std::this_thread::sleep_for(tick);
+                if (duration_cast<milliseconds>(clk::now() - tLast).count() >= perfIntervalMs) { flushPerf(true); tLast = clk::now(); }
+            }
+            flushPerf(true);
+            fmt::print("bench[{}/{}]: workers={} evals={} avgNs={:.0f} maxNs={} nodesPerEval={:.1f} stolen={}\n",
+                       schedName, execName, engine.getWorkers(), totalEvals,
+                       totalEvals ? (double)totalNs / (double)totalEvals : 0.0, worstNs,
+                       totalEvals ? (double)totalNodes / (double)totalEvals : 0.0, totalStolen);
+        };
+        // Side-by-side modes give each run the same duration (default 2s)
+        const int each = (benchDuration > 0) ? benchDuration : 2;
+        if (benchWsDelta) {
+            // The runtime's delta path without sockets: after each eval, record
+            // the changed ports and write one JSON and one binary delta. Heap
+            // allocations inside that path are counted once the reusable
+            // buffers have grown (warm-up); any steady-state allocation fails.
+            constexpr size_t kWarmupEvals = 1000;
+            engine.setPublishSnapshots(true);
+            engine.publishSnapshot();
+            PendingDelta pending;
+            pending.layout(engine.getSnapshot()->descs);
+            NodeFlow::Wire::FrameWriter frame;
+            std::string text;
+            NodeFlow::Generation since = engine.currentEvalGeneration();
+            unsigned long long deltas = 0, ports = 0, ns = 0, allocs = 0;
+            const auto endAt = clk::now() + seconds(each);
+            for (size_t rr = 0; rr < kWarmupEvals || clk::now() < endAt; ++rr) {
+                if (!inputNodes.empty()) engine.setNodeValue(inputNodes[rr % inputNodes.size()], ((rr / inputNodes.size()) & 1) ? 1.0f : 0.0f);
+                engine.execute();
+                const bool counted = rr >= kWarmupEvals;
+                const auto allocs0 = gAllocs.load();
+                gCountAllocs = counted;
+                const auto t0 = clk::now();
+                engine.forEachPortChangedSince(since, [&](NodeFlow::PortHandle h) { pending.record(h, engine.readPort(h), wsDeltaEpsilon); });
+                since = engine.currentEvalGeneration();
+                if (!pending.empty()) {
+                    text.assign("{\"type\":\"delta\"");
+                    frame.begin(NodeFlow::Wire::Kind::Delta, deltas, since);
+                    for (auto h : pending.changed()) {
+                        if (!pending.pending(h)) continue;
+                        pending.appendJson(text, h);
+                        pending.addBinary(frame, h);
+                    }
+                    text += "}\n";
+                    frame.finish();
+                    if (counted) { ++deltas; ports += pending.size(); }
+                    pending.markSent();
+                }
+                const auto t1 = clk::now();
+                gCountAllocs = false;
+                if (counted) {
+                    allocs += gAllocs.load() - allocs0;
+                    ns += (unsigned long long)duration_cast<nanoseconds>(t1 - t0).count();
+                }
+            }
+            if (NODEFLOW_COUNT_ALLOCS) {
+                fmt::print("bench[ws-delta]: deltas={} portsPerDelta={:.1f} nsPerDelta={:.0f} allocs={} allocsPerDelta={:.3f} {}\n",
+                           deltas, deltas ? (double)ports / (double)deltas : 0.0, deltas ? (double)ns / (double)deltas : 0.0,
+                           allocs, deltas ? (double)allocs / (double)deltas : 0.0, allocs == 0 ? "zero-alloc ok" : "ALLOCATES");
+            } else {
+                fmt::print("bench[ws-delta]: deltas={} portsPerDelta={:.1f} nsPerDelta={:.0f} allocs=n/a (build with -DNODEFLOW_COUNT_ALLOCS=ON)\n",
+                           deltas, deltas ? (double)ports / (double)deltas : 0.0, deltas ? (double)ns / (double)deltas : 0.0);
+            }
+            if (perfFp) {
+                if (NODEFLOW_COUNT_ALLOCS) std::fprintf(perfFp, "{\"type\":\"ws_delta\",\"deltas\":%llu,\"ports\":%llu,\"timeNsAccum\":%llu,\"allocs\":%llu}\n", deltas, ports, ns, allocs);
+                else std::fprintf(perfFp, "{\"type\":\"ws_delta\",\"deltas\":%llu,\"ports\":%llu,\"timeNsAccum\":%llu}\n", deltas, ports, ns);
+                std::fclose(perfFp);
+            }
+            return allocs == 0 ? 0 : 1;
+        } else if (benchBatch > 0) {
+            // A device frame of N inputs (cycling over the input handles; with
+            // fewer inputs than N the batch also coalesces repeats). "single"
+            // is N `set` messages each taking the lock and evaluating;
+            // "batch" is one set_many: one lock, one setNodeValues, one eval.
+            const size_t n = static_cast<size_t>(benchBatch);
+            std::mutex benchMutex; // stands in for the runtime's engine lock
+            std::vector<NodeFlow::InputValue> batch(n);
+            auto frameRun = [&](const char* mode, auto&& frame) {
+                unsigned long long frames = 0, ns = 0;
+                engine.getAndResetPerfStats();
+                const auto endAt = clk::now() + seconds(each);
+                for (size_t k = 0; clk::now() < endAt; ++k) {
+                    const float v = (k & 1) ? 1.0f : 0.0f;
+                    const auto t0 = clk::now();
+                    frame(v);
+                    ns += (unsigned long long)duration_cast<nanoseconds>(clk::now() - t0).count();
+                    ++frames;
+                }
+                const auto ps = engine.getAndResetPerfStats();
+                const double inputsPerSec = ns ? (double)(frames * n) * 1e9 / (double)ns : 0.0;
+                fmt::print("bench[batch/{}]: n={} frames={} nsPerFrame={:.0f} inputsPerSec={:.0f} evals={} nodesPerFrame={:.1f}\n", mode, n, frames,
+                           frames ? (double)ns / (double)frames : 0.0, inputsPerSec, ps.evalCount,
+                           frames ? (double)ps.nodesEvaluated / (double)frames : 0.0);
+                if (perfFp) {
+                    std::fprintf(perfFp, "{\"type\":\"batch\",\"mode\":\"%s\",\"n\":%zu,\"frames\":%llu,\"timeNsAccum\":%llu,\"evalCount\":%llu,\"nodesEvaluated\":%llu}\n",
+                                 mode, n, frames, ns, ps.evalCount, ps.nodesEvaluated);
+                    std::fflush(perfFp);
+                }
+            };
+            frameRun("single", [&](float v) {
+                for (size_t i = 0; i < n; ++i) {
+                    std::lock_guard<std::mutex> lock(benchMutex);
+                    engine.setNodeValue(inputNodes[i % inputNodes.size()], v);
+                    engine.execute();
+                }
+            });
+            frameRun("batch", [&](float v) {
+                for (size_t i = 0; i < n; ++i) batch[i] = {inputHandles[i % inputHandles.size()], v};
+                std::lock_guard<std::mutex> lock(benchMutex);
+                engine.setNodeValues(batch);
+                engine.execute();
+            });
+        } else if (benchShmIn) {
+            // Producer threads feed the DeviceTrigger handles as fast as they
+            // can while this thread evaluates whenever work is pending.
+            // "queue" posts through the in-process input queue (what the WS
+            // thread uses); "shm" pushes records through nodeflow_shm.h into
+            // the ring, as an out-of-process driver would. Latency is push
+            // timestamp to the end of the eval that applied it.
+            const int producers = std::max(1, benchShmProducers);
+            auto shmRun = [&](const char* mode, auto&& push) {
+                std::atomic<bool> stop{false};
+                std::atomic<unsigned long long> pushed{0};
+                engine.getAndResetPerfStats();
+                std::vector<std::thread> threads;
+                for (int p = 0; p < producers; ++p) {
+                    threads.emplace_back([&, p] {
+                        unsigned long long n = 0;
+                        for (size_t k = static_cast<size_t>(p); !stop.load(std::memory_order_relaxed); k += static_cast<size_t>(producers)) {
+                            // Toggle per visit of this handle, so every push is a change
+                            const float v = ((k / inputHandles.size()) & 1) ? 1.0f : 0.0f;
+                            n += push(p, inputHandles[k % inputHandles.size()], v) ? 1 : 0;
+                        }
+                        pushed.fetch_add(n, std::memory_order_relaxed);
+                    });
+                }
+                unsigned long long evals = 0;
+                const auto t0 = clk::now();
+                const auto endAt = t0 + seconds(each);
+                while (clk::now() < endAt) {
+                    if (engine.hasPendingWork()) { engine.execute(); ++evals; }
+                    else cpuRelax();
+                }
+                stop = true;
+                for (auto &t : threads) t.join();
+                while (engine.hasPendingWork()) { engine.execute(); ++evals; } // what the producers left queued
+                const double secs = duration<double>(clk::now() - t0).count();
+                const auto ps = engine.getAndResetPerfStats();
+                fmt::print("bench[shm-in/{}]: producers={} pushed={} inputsPerSec={:.0f} drained={} coalesced={} dropped={} evals={} latencyNs p50={} p99={} max={}\n",
+                           mode, producers, pushed.load(), (double)pushed.load() / secs, ps.inputsDrained, ps.inputsCoalesced,
+                           ps.inputsDropped, evals, ps.latencyPercentile(0.50), ps.latencyPercentile(0.99), ps.inputLatencyNsMax);
+                if (perfFp) {
+                    std::fprintf(perfFp, "{\"type\":\"shm_in\",\"mode\":\"%s\",\"producers\":%d,\"pushed\":%llu,\"seconds\":%.3f,\"inputsDrained\":%llu,\"inputsCoalesced\":%llu,\"inputsDropped\":%llu,\"evalCount\":%llu,\"latencyNsP50\":%llu,\"latencyNsP99\":%llu,\"latencyNsMax\":%llu}\n",
+                                 mode, producers, pushed.load(), secs, ps.inputsDrained, ps.inputsCoalesced, ps.inputsDropped, evals,
+                                 ps.latencyPercentile(0.50), ps.latencyPercentile(0.99), ps.inputLatencyNsMax);
+                    std::fflush(perfFp);
+                }
+            };
+            shmRun("queue", [&](int, NodeFlow::PortHandle h, float v) { return engine.postInput(h, v); });
+            // Each producer attaches on its own, like a separate process would
+            std::vector<nodeflow_shm_in> attached(static_cast<size_t>(producers));
+            for (auto &r : attached) {
+                if (nodeflow_shm_in_open(&r, shmRing->name().c_str()) != 0) { fmt::print("bench[shm-in]: cannot attach {}\n", shmRing->name()); return 1; }
+            }
+            shmRun("shm", [&](int p, NodeFlow::PortHandle h, float v) {
+                return nodeflow_shm_in_push_float(&attached[static_cast<size_t>(p)], h, v) == 1;
+            });
+            for (auto &r : attached) nodeflow_shm_in_close(&r);
+        } else if (benchInstances > 0) {
+            // Same feeder for both: every instance toggles one trigger per eval
+            const size_t n = static_cast<size_t>(benchInstances);
+            auto report = [&](const char* mode, unsigned long long evals, unsigned long long ns) {
+                fmt::print("bench[{}]: instances={} evals={} avgNs={:.0f} nsPerInstance={:.1f}\n", mode, n, evals,
+                           evals ? (double)ns / (double)evals : 0.0,
+                           evals ? (double)ns / (double)evals / (double)n : 0.0);
+            };
+            auto timedLoop = [&](auto&& step) {
+                unsigned long long evals = 0, ns = 0;
+                const auto endAt = clk::now() + seconds(each);
+                for (size_t rr = 0; clk::now() < endAt; ++rr) {
+                    const auto t0 = clk::now();
+                    step(rr);
+                    ns += (unsigned long long)duration_cast<nanoseconds>(clk::now() - t0).count();
+                    ++evals;
+                }
+                return std::make_pair(evals, ns);
+            };
+            auto feed = [&](size_t rr) { return ((rr / inputNodes.size()) & 1) ? 1.0f : 0.0f; };
+            {
+                std::vector<NodeFlow::FlowEngine> engines(n);
+                for (auto &e : engines) e.loadFromJson(json);
+                auto r = timedLoop([&](size_t rr) {
+                    const auto &node = inputNodes[rr % inputNodes.size()];
+                    for (auto &e : engines) { e.setNodeValue(node, feed(rr)); e.execute(); }
+                });
+                report("engines", r.first, r.second);
+            }
+            {
+                NodeFlow::BatchFlowEngine batch;
+                batch.loadFromJson(json, n);
+                auto r = timedLoop([&](size_t rr) {
+                    const auto &node = inputNodes[rr % inputNodes.size()];
+                    for (size_t i = 0; i < n; ++i) batch.setNodeValue(i, node, feed(rr));
+                    batch.execute();
+                });
+                report("batch", r.first, r.second);
+            }
+        } else if (benchExecutors) {
+            const int parallelWorkers = std::max(workers, 2);
+            engine.setWorkers(1);
+            runBench(each);
+            engine.setWorkers(parallelWorkers);
+            engine.setParallelMode(Engine::ParallelMode::Levels);
+            runBench(each);
+            engine.setParallelMode(Engine::ParallelMode::WorkStealing);
+            runBench(each);
+        } else if (benchScheduler == "both") {
+            engine.setScheduler(Engine::Scheduler::LegacyQueue);
+            runBench(each);
+            engine.setScheduler(Engine::Scheduler::Bitset);
+            runBench(each);
+        } else {
+            engine.setScheduler(benchScheduler == "legacy" ? Engine::Scheduler::LegacyQueue : Engine::Scheduler::Bitset);
+            runBench(benchDuration);
+        }
+        if (perfFp) std::fclose(perfFp);
         return 0;
     }
 
+    // Snapshots for WS clients are read from the engine's published view, so
+    // building them never waits on an eval in progress
+    engine.setPublishSnapshots(true);
+    engine.publishSnapshot();
+
     // WebSocket server (headless IPC)
     using WsServer = SimpleWeb::SocketServer<SimpleWeb::WS>;
     std::unique_ptr<WsServer> wsServer;
     std::thread wsThread;
     std::mutex wsMutex;
     std::mutex engineMutex;
-    std::string latestJson; // last snapshot/delta, for simple demo
-    // Delta aggregation state
-    std::unordered_map<std::string, std::string> pendingDelta;
+    // Serialized messages are immutable and shared: a payload is written once
+    // into an SWS OutMessage and every connection's send queue references
+    // that same buffer (SWS writes from it without consuming it)
+    using Payload = std::shared_ptr<const std::string>;
+    using Frame = std::shared_ptr<WsServer::OutMessage>;
+    auto share = [](std::string &&s) { return s.empty() ? Payload() : std::make_shared<const std::string>(std::move(s)); };
+    auto makeFrame = [](const std::string &s) {
+        auto f = std::make_shared<WsServer::OutMessage>(s.size());
+        f->write(s.data(), static_cast<std::streamsize>(s.size()));
+        return f;
+    };
+    bool wsCopyPerClient = false; // one frame per connection (--bench-ws-clients baseline)
+    Payload latestJson; // last snapshot/delta, for simple demo
+    // Delta aggregation state, and the buffers deltas are written into
+    PendingDelta pendingDelta;
+    std::string deltaText;
+    NodeFlow::Wire::FrameWriter deltaFrame;
     auto lastFlush = std::chrono::steady_clock::now();
     auto lastActivity = std::chrono::steady_clock::now();
     std::string wsRegex; // compiled endpoint regex key for lookups
+    // Node id -> handle used to post `set` inputs without the engine lock.
+    // Only the WS thread edits the graph, so it rebuilds this itself after
+    // every load/edit.
+    std::unordered_map<std::string, NodeFlow::PortHandle> inputHandleByNode;
+    // Port handle -> first output of its node (-1 if none), for set_many deltas
+    std::vector<NodeFlow::PortHandle> outputOfHandle;
+    auto refreshInputHandles = [&]() {
+        inputHandleByNode.clear();
+        outputOfHandle.assign(engine.getPortDescs().size(), -1);
+        for (const auto &n : engine.getNodeDescs()) {
+            if (n.removed) continue;
+            if (!n.outputPorts.empty()) inputHandleByNode[n.id] = n.outputPorts[0];
+            else if (!n.inputPorts.empty()) inputHandleByNode[n.id] = n.inputPorts[0];
+            const NodeFlow::PortHandle out = n.outputPorts.empty() ? -1 : n.outputPorts[0];
+            for (auto h : n.inputPorts) outputOfHandle[h] = out;
+            for (auto h : n.outputPorts) outputOfHandle[h] = out;
+        }
+    };
+    refreshInputHandles();
+    // Per-connection state, set by {"type":"subscribe",...}: wire format and
+    // the ports the client watches. Identical subscriptions share one
+    // Subscription so fan-out serializes each message once per distinct
+    // (subscription, format) group. The counts let senders skip a format no
+    // client uses.
+    struct Subscription {
+        std::vector<std::uint64_t> bits;           // port handle bitset
+        std::vector<NodeFlow::PortHandle> handles; // set bits, ascending
+        bool has(NodeFlow::PortHandle h) const {
+            return h >= 0 && static_cast<size_t>(h >> 6) < bits.size() && ((bits[h >> 6] >> (h & 63)) & 1);
+        }
+    };
+    struct SubscriptionSpec {
+        bool all = true; // no filter
+        std::vector<NodeFlow::PortHandle> handles;
+        std::vector<std::string> nodes;    // every port of these nodes
+        std::vector<std::string> patterns; // globs over "node:port" (or the node id when there is no ':')
+    };
+    // Outbound flow control: bytes handed to the socket and not yet written,
+    // shared with send callbacks (which may outlive the client entry)
+    struct ClientFlow {
+        std::atomic<size_t> queuedBytes{0};
+        std::atomic<unsigned> queuedMsgs{0};
+        std::atomic<bool> waiting{false}; // has a backlog; wake the loop once drained
+    };
+    struct WsClient {
+        unsigned long long id = 0;
+        bool binary = false;
+        SubscriptionSpec spec;
+        std::shared_ptr<const Subscription> sub; // null = every port
+        std::shared_ptr<ClientFlow> flow = std::make_shared<ClientFlow>();
+        // While behind, deltas merge here (latest value per handle, so at
+        // most one entry per watched port) instead of being queued
+        std::unordered_map<NodeFlow::PortHandle, std::pair<std::string, std::string>> backlogText;
+        std::unordered_map<NodeFlow::PortHandle, NodeFlow::Value> backlogBinary;
+        bool needResync = false; // a snapshot supersedes the backlog
+        bool behind = false;
+        std::chrono::steady_clock::time_point behindSince{};
+        size_t maxQueuedBytes = 0;
+        unsigned long long sentMsgs = 0, dropped = 0, resyncs = 0;
+        bool hasBacklog() const { return needResync || !backlogText.empty() || !backlogBinary.empty(); }
+        void clearBacklog() { backlogText.clear(); backlogBinary.clear(); }
+    };
+    std::mutex wsClientsMutex;
+    std::unordered_map<const void*, WsClient> wsClients;
+    std::shared_ptr<const Subscription> watchedPorts; // union of all subscriptions; null = every port
+    std::atomic<int> wsTextClients{0}, wsBinaryClients{0};
+    std::atomic<unsigned long long> wireSeq{0};
+    unsigned long long wsClientIds = 0;
+    std::atomic<unsigned long long> wsDroppedTotal{0}, wsResyncTotal{0}; // since the last perf line
+    const size_t wsClientQueueBytes = static_cast<size_t>(std::max(1, wsClientQueueKb)) * 1024;
+    // Resolve a spec against the current descriptors, reusing an equal
+    // subscription held by another client. Caller holds wsClientsMutex.
+    auto resolveSubscription = [&](const SubscriptionSpec &spec, const std::vector<NodeFlow::PortDesc> &descs) -> std::shared_ptr<const Subscription> {
+        if (spec.all) return nullptr;
+        auto sub = std::make_shared<Subscription>();
+        sub->bits.assign((descs.size() + 63) / 64, 0);
+        auto add = [&](NodeFlow::PortHandle h) {
+            if (h >= 0 && static_cast<size_t>(h) < descs.size() && !descs[h].removed) sub->bits[h >> 6] |= 1ull << (h & 63);
+        };
+        for (auto h : spec.handles) add(h);
+        if (!spec.nodes.empty() || !spec.patterns.empty()) {
+            for (const auto &p : descs) {
+                if (p.removed) continue;
+                bool match = std::find(spec.nodes.begin(), spec.nodes.end(), p.nodeId) != spec.nodes.end();
+                for (size_t i = 0; !match && i < spec.patterns.size(); ++i) {
+                    const auto &pat = spec.patterns[i];
+                    match = pat.find(':') == std::string::npos ? globMatch(pat, p.nodeId) : globMatch(pat, p.nodeId + ":" + p.portId);
+                }
+                if (match) add(p.handle);
+            }
+        }
+        for (size_t w = 0; w < sub->bits.size(); ++w) {
+            for (std::uint64_t b = sub->bits[w]; b; b &= b - 1) sub->handles.push_back(static_cast<NodeFlow::PortHandle>(w * 64 + __builtin_ctzll(b)));
+        }
+        for (const auto &kv : wsClients) {
+            if (kv.second.sub && kv.second.sub->bits == sub->bits) return kv.second.sub;
+        }
+        return sub;
+    };
+    // Recompute the union the delta accumulator keeps. Caller holds wsClientsMutex.
+    auto updateWatchedPorts = [&]() {
+        std::shared_ptr<Subscription> all;
+        for (const auto &kv : wsClients) {
+            if (!kv.second.sub) { watchedPorts = nullptr; return; }
+            if (!all) { all = std::make_shared<Subscription>(*kv.second.sub); continue; }
+            if (all->bits.size() < kv.second.sub->bits.size()) all->bits.resize(kv.second.sub->bits.size(), 0);
+            for (size_t w = 0; w < kv.second.sub->bits.size(); ++w) all->bits[w] |= kv.second.sub->bits[w];
+        }
+        if (all) all->handles.clear(); // only has() is used on the union
+        watchedPorts = all;
+    };
+    auto registerClient = [&](const void* c) {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto ins = wsClients.emplace(c, WsClient{});
+        if (ins.second) { ins.first->second.id = ++wsClientIds; ++wsTextClients; }
+        updateWatchedPorts();
+    };
+    auto unregisterClient = [&](const void* c) {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto it = wsClients.find(c);
+        if (it == wsClients.end()) return;
+        if (it->second.binary) --wsBinaryClients; else --wsTextClients;
+        wsClients.erase(it);
+        updateWatchedPorts();
+    };
+    // Returns the number of ports the client now watches (all live ports when unfiltered)
+    auto subscribeClient = [&](const void* c, bool binary, SubscriptionSpec spec) {
+        const auto descs = engine.getSnapshot()->descs;
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto &cl = wsClients[c];
+        if (cl.binary != binary) {
+            if (binary) { --wsTextClients; ++wsBinaryClients; } else { --wsBinaryClients; ++wsTextClients; }
+            cl.binary = binary;
+        }
+        cl.spec = std::move(spec);
+        cl.sub = resolveSubscription(cl.spec, *descs);
+        // The caller sends a baseline snapshot for the new subscription
+        cl.clearBacklog();
+        cl.needResync = false;
+        updateWatchedPorts();
+        if (cl.sub) return cl.sub->handles.size();
+        return static_cast<size_t>(std::count_if(descs->begin(), descs->end(), [](const NodeFlow::PortDesc &p) { return !p.removed; }));
+    };
+    // Re-resolve every subscription after the graph changed (new nodes may match)
+    auto refreshSubscriptions = [&]() {
+        const auto descs = engine.getSnapshot()->descs;
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &kv : wsClients) kv.second.sub.reset();
+        for (auto &kv : wsClients) kv.second.sub = resolveSubscription(kv.second.spec, *descs);
+        updateWatchedPorts();
+    };
+    auto clientSubscription = [&](const void* c) {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto it = wsClients.find(c);
+        return it == wsClients.end() ? std::shared_ptr<const Subscription>() : it->second.sub;
+    };
+    // Send with flow accounting; the callback runs on the WS thread once the
+    // bytes are written (or the connection fails)
+    auto sendTracked = [&](const std::shared_ptr<WsServer::Connection> &c, WsClient &cl, const Frame &frame, bool binary) {
+        auto flow = cl.flow;
+        const size_t n = frame->size();
+        const size_t queued = flow->queuedBytes.fetch_add(n) + n;
+        ++flow->queuedMsgs;
+        cl.maxQueuedBytes = std::max(cl.maxQueuedBytes, queued);
+        ++cl.sentMsgs;
+        auto onSent = [flow, n, &engine, limit = wsClientQueueBytes](const SimpleWeb::error_code &) {
+            const size_t left = flow->queuedBytes.fetch_sub(n) - n;
+            --flow->queuedMsgs;
+            if (left <= limit && flow->waiting.exchange(false)) engine.wake(); // flush its backlog
+        };
+        if (binary) c->send(frame, onSent, NodeFlow::Wire::kBinaryOpcode);
+        else c->send(frame, onSent);
+    };
+    auto isBehind = [&](const WsClient &cl) { return cl.flow->queuedBytes.load() > wsClientQueueBytes; };
+    // Send one message per distinct (subscription, format) group: build(sub,
+    // binary) runs once per group, its payload becomes one frame shared by the
+    // group's connections, and a null payload sends nothing. A client
+    // that is behind (or still has a backlog, which must not be overtaken)
+    // gets coalesce(client) instead, which merges the message into its
+    // backlog and returns false when the message had nothing for it.
+    auto fanOut = [&](const std::function<Payload(const Subscription*, bool)> &build,
+                      const std::function<bool(WsClient&)> &coalesce) {
+        auto it_ep = wsServer->endpoint.find(wsRegex);
+        if (it_ep == wsServer->endpoint.end()) return;
+        struct Group { const Subscription* sub; bool binary; Payload payload; Frame frame; };
+        std::vector<Group> groups;
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &c : it_ep->second.get_connections()) {
+            auto itc = wsClients.find(c.get());
+            if (itc == wsClients.end()) continue; // not opened yet
+            WsClient &cl = itc->second;
+            if (isBehind(cl) || cl.hasBacklog()) {
+                if (!cl.behind && isBehind(cl)) { cl.behind = true; cl.behindSince = now; }
+                if (coalesce(cl)) { ++cl.dropped; ++wsDroppedTotal; }
+                if (cl.hasBacklog()) cl.flow->waiting = true;
+                continue;
+            }
+            auto g = std::find_if(groups.begin(), groups.end(), [&](const Group &x) { return x.sub == cl.sub.get() && x.binary == cl.binary; });
+            if (g == groups.end()) {
+                Payload payload = build(cl.sub.get(), cl.binary);
+                Frame frame = (payload && !wsCopyPerClient) ? makeFrame(*payload) : nullptr;
+                g = groups.insert(groups.end(), Group{cl.sub.get(), cl.binary, std::move(payload), std::move(frame)});
+            }
+            if (g->payload) sendTracked(c, cl, wsCopyPerClient ? makeFrame(*g->payload) : g->frame, cl.binary);
+        }
+    };
+    // Coalescing for snapshots: the next one supersedes whatever is pending
+    auto resyncLater = [](WsClient &cl) { cl.clearBacklog(); cl.needResync = true; return true; };
+    auto addBinaryValue = [](NodeFlow::Wire::FrameWriter &w, NodeFlow::PortHandle h, const NodeFlow::Value &v) {
+        const auto u = static_cast<std::uint32_t>(h);
+        if (std::holds_alternative<int>(v)) w.addInt(u, std::get<int>(v));
+        else if (std::holds_alternative<float>(v)) w.addFloat(u, std::get<float>(v));
+        else if (std::holds_alternative<double>(v)) w.addDouble(u, std::get<double>(v));
+        else w.addString(u, std::get<std::string>(v));
+    };
     // Timing metadata helpers available across WS handlers and main loop
     using SteadyClock = std::chrono::steady_clock;
     using SystemClock = std::chrono::system_clock;
     auto processStartSteady = SteadyClock::now();
-    unsigned long long msgSeq = 0;
-    double lastDtMsObserved = 0.0;
+    // Written by the stepping thread, read by WS/publisher threads in buildT
+    std::atomic<unsigned long long> msgSeq{0};
+    std::atomic<double> lastDtMsObserved{0.0};
     auto buildT = [&]() {
         if (!wsIncludeTime) return std::string();
         auto nowSteady = SteadyClock::now();
         auto nowSys = SystemClock::now();
         auto wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(nowSys.time_since_epoch()).count();
         auto monoNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nowSteady - processStartSteady).count();
-        ++msgSeq;
+        const unsigned long long seq = msgSeq.fetch_add(1, std::memory_order_relaxed) + 1;
         std::string t = ",\"t\":{\"wall_ms\":" + std::to_string((long long)wallMs)
                         + ",\"mono_ns\":" + std::to_string((long long)monoNs)
-                        + ",\"dt_ms\":" + fmt::format("{:.3f}", lastDtMsObserved)
+                        + ",\"dt_ms\":" + fmt::format("{:.3f}", lastDtMsObserved.load(std::memory_order_relaxed))
                         + ",\"clock\":\"" + clockType + "\""
                         + ",\"time_scale\":" + fmt::format("{:.3f}", timeScale)
                         + ",\"rate_hz\":" + std::to_string(fixedRateHz)
-                        + ",\"seq\":" + std::to_string((long long)msgSeq) + "}";
+                        + ",\"seq\":" + std::to_string((long long)seq) + "}";
         return t;
     };
+    // Snapshot of the live output ports of a published view (lock-free: a
+    // published snapshot is immutable), limited to `sub` when set
+    auto encodeSnapshot = [&](const NodeFlow::FlowEngine::PortSnapshot &view, const Subscription* sub, bool binary) {
+        const auto &descs = *view.descs;
+        auto visit = [&](auto &&f) {
+            if (!sub) {
+                for (const auto &p : descs) if (p.direction == "output" && !p.removed) f(p);
+                return;
+            }
+            for (auto h : sub->handles) {
+                if (static_cast<size_t>(h) < descs.size() && descs[h].direction == "output" && !descs[h].removed) f(descs[h]);
+            }
+        };
+        if (binary) {
+            NodeFlow::Wire::FrameWriter w;
+            w.begin(NodeFlow::Wire::Kind::Snapshot, ++wireSeq, view.generation);
+            visit([&](const NodeFlow::PortDesc &p) { addBinaryValue(w, p.handle, view.read(p.handle)); });
+            return std::string(w.finish());
+        }
+        std::string js = "{\"type\":\"snapshot\"";
+        js += buildT();
+        visit([&](const NodeFlow::PortDesc &p) {
+            // canonical key
+            js += ",\""; js += p.nodeId; js += ":"; js += p.portId; js += "\":";
+            js += valueToJson(view.read(p.handle));
+        });
+        js += "}\n";
+        return js;
+    };
+    // Current snapshot to every client, serialized once per group
+    auto fanOutSnapshot = [&]() {
+        const auto view = engine.getSnapshot();
+        fanOut([&](const Subscription* sub, bool binary) {
+            Payload snap = share(encodeSnapshot(*view, sub, binary));
+            if (!sub && !binary) {
+                std::lock_guard<std::mutex> lock(wsMutex);
+                latestJson = snap;
+            }
+            return snap;
+        }, resyncLater);
+    };
     {
         wsServer = std::make_unique<WsServer>();
         wsServer->config.port = wsPort;
@@ -249,60 +1104,32 @@ int main(int argc, char** argv) {
             s += buildT();
             s += ",";
             s += "\"nodes\":[";
-            for (size_t i = 0; i < nodes.size(); ++i) {
-                const auto &n = nodes[i];
-                if (i) s += ",";
+            bool first = true;
+            for (const auto &n : nodes) {
+                if (n.removed) continue;
+                if (!first) s += ",";
+                first = false;
                 s += "{\"id\":\"" + n.id + "\",\"type\":\"" + n.type + "\"}";
             }
             s += "],";
             s += "\"ports\":[";
-            for (size_t i = 0; i < ports.size(); ++i) {
-                const auto &p = ports[i];
-                if (i) s += ",";
+            first = true;
+            for (const auto &p : ports) {
+                if (p.removed) continue;
+                if (!first) s += ",";
+                first = false;
                 s += "{\"handle\":" + std::to_string(p.handle)
                    + ",\"nodeId\":\"" + p.nodeId + "\""
                    + ",\"portId\":\"" + p.portId + "\""
                    + ",\"direction\":\"" + p.direction + "\""
-                   + ",\"dtype\":\"" + p.dataType + "\"}";
+                   + ",\"dtype\":\"" + p.dataType + "\""
+                   + (p.deadband > 0.0 ? ",\"deadband\":" + fmt::format("{}", p.deadband) : std::string())
+                   + "}";
             }
             s += "]}\n";
             return s;
         };
 
-        auto valueToJson = [](const NodeFlow::Value &v) -> std::string {
-            if (std::holds_alternative<float>(v)) return jsonNumberForDtype("float", (double)std::get<float>(v), 3);
-            if (std::holds_alternative<double>(v)) return jsonNumberForDtype("double", (double)std::get<double>(v), 3);
-            if (std::holds_alternative<int>(v)) return jsonNumberForDtype("int", (double)std::get<int>(v), 3);
-            if (std::holds_alternative<std::string>(v)) {
-                const auto &s = std::get<std::string>(v);
-                std::string esc; esc.reserve(s.size()+2);
-                esc.push_back('"');
-                for (char c : s) { if (c=='"' || c=='\\') esc.push_back('\\'); esc.push_back(c);} 
-                esc.push_back('"');
-                return esc;
-            }
-            return "null";
-        };
-
-        auto buildSnapshot = [&]() {
-            std::lock_guard<std::mutex> engLock(engineMutex);
-            std::string js = "{\"type\":\"snapshot\"";
-            js += buildT();
-            const auto &ports = engine.getPortDescs();
-            // count outputs per node
-            std::unordered_map<std::string,int> outCount;
-            for (const auto &p : ports) if (p.direction == "output") ++outCount[p.nodeId];
-            for (const auto &p : ports) {
-                if (p.direction != "output") continue;
-                auto val = engine.readPort(p.handle);
-                // canonical key
-                js += ",\""; js += p.nodeId; js += ":"; js += p.portId; js += "\":";
-                js += valueToJson(val);
-            }
-            js += "}\n";
-            return js;
-        };
-
         ep.on_message = [&, wsPattern](auto conn, auto msg){
             try {
                 auto data = msg->string();
@@ -336,38 +1163,28 @@ int main(int argc, char** argv) {
                 };
                 auto type = getStr("type");
                 auto broadcastSnapshot = [&](){
-                    std::string snap = buildSnapshot();
-                    {
-                        std::lock_guard<std::mutex> lock(wsMutex);
-                        latestJson = snap;
-                    }
-                    auto it_ep = wsServer->endpoint.find(wsRegex);
-                    if (it_ep != wsServer->endpoint.end()) {
-                        for (auto &c2 : it_ep->second.get_connections()) {
-                            c2->send(snap);
-                        }
-                    }
+                    fanOutSnapshot();
                     lastActivity = std::chrono::steady_clock::now();
                 };
                 if (type == "set") {
                     float value = static_cast<float>(getNum("value"));
+                    // Inputs go through the engine's lock-free queue and are
+                    // applied at the start of the next eval
+                    bool queued = true;
+                    const auto view = engine.getSnapshot();
+                    const auto &ports = *view->descs;
                     if (hasKey("handle")) {
                         int handle = static_cast<int>(getNum("handle"));
-                        const auto &ports = engine.getPortDescs();
-                        if (handle >= 0 && static_cast<size_t>(handle) < ports.size()) {
-                            const auto &pd = ports[handle];
-                            // For device inputs/outputs, set node value
-                            {
-                                std::lock_guard<std::mutex> engLock2(engineMutex);
-                                engine.setNodeValue(pd.nodeId, value);
-                            }
+                        if (handle >= 0 && static_cast<size_t>(handle) < ports.size() && !ports[handle].removed) {
+                            queued = engine.postInput(handle, value);
                         }
                     } else {
-                        auto node = getStr("node");
-                        {
-                            std::lock_guard<std::mutex> engLock3(engineMutex);
-                            engine.setNodeValue(node, value);
-                        }
+                        auto itH = inputHandleByNode.find(getStr("node"));
+                        if (itH != inputHandleByNode.end()) queued = engine.postInput(itH->second, value);
+                    }
+                    if (!queued) {
+                        conn->send("{\"ok\":false,\"err\":\"input queue full\"}\n");
+                        return;
                     }
                     conn->send("{\"ok\":true}\n");
                     if (wsDeltaFast) {
@@ -375,32 +1192,134 @@ int main(int argc, char** argv) {
                         std::string node;
                         if (hasKey("handle")) {
                             int h2 = static_cast<int>(getNum("handle"));
-                            const auto &ports2 = engine.getPortDescs();
-                            if (h2 >= 0 && static_cast<size_t>(h2) < ports2.size()) node = ports2[h2].nodeId;
+                            if (h2 >= 0 && static_cast<size_t>(h2) < ports.size()) node = ports[h2].nodeId;
                         } else {
                             node = getStr("node");
                         }
                         // Prefer canonical key nodeId:portId for deltas
                         std::string key = node;
-                        const auto &ports2b = engine.getPortDescs();
-                        for (const auto &p2 : ports2b) {
-                            if (p2.nodeId == node && p2.direction == "output") { key = node + ":" + p2.portId; break; }
+                        NodeFlow::PortHandle outHandle = -1;
+                        for (const auto &p2 : ports) {
+                            if (p2.nodeId == node && p2.direction == "output" && !p2.removed) { key = node + ":" + p2.portId; outHandle = p2.handle; break; }
                         }
-                        // Value as formatted JSON number (use node's first output dtype if available)
-                        std::string dtype = "float";
-                        for (const auto &p2b : engine.getPortDescs()) { if (p2b.nodeId == node && p2b.direction == "output") { dtype = p2b.dataType; break; } }
-                        std::string val = jsonNumberForDtype(dtype, (double)value, 3);
-                std::string delta = std::string("{\"type\":\"delta\"");
-                delta += buildT();
-                delta += ",\"" + key + "\":" + val + "}\n";
-                        auto it_ep = wsServer->endpoint.find(wsRegex);
-                        if (it_ep != wsServer->endpoint.end()) {
-                            for (auto &c2 : it_ep->second.get_connections()) c2->send(delta);
+                        // Apply the input now and send what the engine stored
+                        // (deadband and dtype applied), like set_many
+                        NodeFlow::Value outValue;
+                        NodeFlow::Generation gen;
+                        {
+                            std::lock_guard<std::mutex> engLock2(engineMutex);
+                            engine.drainInputs();
+                            engine.publishSnapshot();
+                            gen = engine.currentEvalGeneration();
+                            if (outHandle >= 0) outValue = engine.readPort(outHandle);
                         }
+                        engine.wake(); // evaluate the consumers it scheduled
+                        if (outHandle < 0) return;
+                        fanOut([&](const Subscription* sub, bool binary) -> Payload {
+                            // Filtered clients only get ports they watch
+                            if (sub && !sub->has(outHandle)) return {};
+                            if (binary) {
+                                NodeFlow::Wire::FrameWriter w;
+                                w.begin(NodeFlow::Wire::Kind::Delta, ++wireSeq, gen);
+                                addBinaryValue(w, outHandle, outValue);
+                                return share(std::string(w.finish()));
+                            }
+                            std::string delta = std::string("{\"type\":\"delta\"");
+                            delta += buildT();
+                            delta += ",\"" + key + "\":" + valueToJson(outValue) + "}\n";
+                            return share(std::move(delta));
+                        }, [&](WsClient &cl) {
+                            if (cl.sub && !cl.sub->has(outHandle)) return false;
+                            if (cl.needResync) return true;
+                            if (!cl.binary) cl.backlogText[outHandle] = {key, valueToJson(outValue)};
+                            else cl.backlogBinary[outHandle] = outValue;
+                            return true;
+                        });
                         lastActivity = std::chrono::steady_clock::now();
                     } else {
+                        // The snapshot must include this input
+                        {
+                            std::lock_guard<std::mutex> engLock2(engineMutex);
+                            engine.drainInputs();
+                            engine.publishSnapshot();
+                        }
+                        engine.wake(); // evaluate the consumers it scheduled
                         broadcastSnapshot();
                     }
+                } else if (type == "set_many") {
+                    // {"type":"set_many","handles":[...],"values":[...]}: one
+                    // atomic update under a single lock, evaluated as one wave.
+                    // setNodeValues drains earlier queued sets first, so a
+                    // preceding "set" cannot land after the batch.
+                    const nlohmann::json cmd = nlohmann::json::parse(data);
+                    const auto &hs = cmd.at("handles");
+                    const auto &vs = cmd.at("values");
+                    if (!hs.is_array() || !vs.is_array() || hs.size() != vs.size()) {
+                        conn->send("{\"ok\":false,\"err\":\"handles and values must be arrays of equal length\"}\n");
+                        return;
+                    }
+                    std::vector<NodeFlow::InputValue> batch(hs.size());
+                    for (size_t i = 0; i < batch.size(); ++i) batch[i] = {hs[i].get<NodeFlow::PortHandle>(), vs[i].get<float>()};
+                    size_t applied;
+                    // Output ports the batch set, with their new values
+                    std::vector<std::pair<NodeFlow::PortHandle, NodeFlow::Value>> outs;
+                    NodeFlow::Generation gen;
+                    {
+                        std::lock_guard<std::mutex> engLock(engineMutex);
+                        applied = engine.setNodeValues(batch);
+                        engine.publishSnapshot();
+                        gen = engine.currentEvalGeneration();
+                        if (wsDeltaFast) {
+                            for (const auto &b : batch) {
+                                if (b.handle < 0 || static_cast<size_t>(b.handle) >= outputOfHandle.size() || outputOfHandle[b.handle] < 0) continue;
+                                const auto out = outputOfHandle[b.handle];
+                                if (std::none_of(outs.begin(), outs.end(), [&](const auto &o) { return o.first == out; })) outs.emplace_back(out, engine.readPort(out));
+                            }
+                        }
+                    }
+                    engine.wake(); // one eval for the whole batch
+                    conn->send(fmt::format("{{\"ok\":true,\"applied\":{}}}\n", applied));
+                    if (!wsDeltaFast) {
+                        broadcastSnapshot();
+                        return;
+                    }
+                    if (outs.empty()) return;
+                    // One delta with every port the batch set
+                    const auto view = engine.getSnapshot();
+                    const auto &ports = *view->descs;
+                    auto keyOf = [&](NodeFlow::PortHandle h) { return ports[h].nodeId + ":" + ports[h].portId; };
+                    fanOut([&](const Subscription* sub, bool binary) -> Payload {
+                        if (binary) {
+                            NodeFlow::Wire::FrameWriter w;
+                            w.begin(NodeFlow::Wire::Kind::Delta, 0, gen);
+                            for (const auto &o : outs) if (!sub || sub->has(o.first)) addBinaryValue(w, o.first, o.second);
+                            if (w.records() == 0) return {};
+                            w.setSequence(++wireSeq);
+                            return share(std::string(w.finish()));
+                        }
+                        std::string delta = "{\"type\":\"delta\"";
+                        delta += buildT();
+                        bool any = false;
+                        for (const auto &o : outs) {
+                            if (sub && !sub->has(o.first)) continue;
+                            delta += ",\"" + keyOf(o.first) + "\":" + valueToJson(o.second);
+                            any = true;
+                        }
+                        if (!any) return {};
+                        delta += "}\n";
+                        return share(std::move(delta));
+                    }, [&](WsClient &cl) {
+                        bool merged = false;
+                        for (const auto &o : outs) {
+                            if (cl.sub && !cl.sub->has(o.first)) continue;
+                            merged = true;
+                            if (cl.needResync) continue;
+                            if (cl.binary) cl.backlogBinary[o.first] = o.second;
+                            else cl.backlogText[o.first] = {keyOf(o.first), valueToJson(o.second)};
+                        }
+                        return merged;
+                    });
+                    lastActivity = std::chrono::steady_clock::now();
                 } else if (type == "config") {
                     auto node = getStr("node");
                     int minI = static_cast<int>(getNum("min_interval"));
@@ -408,6 +1327,7 @@ int main(int argc, char** argv) {
                     {
                         std::lock_guard<std::mutex> engLock4(engineMutex);
                         engine.setNodeConfigMinMax(node, minI, maxI);
+                        engine.publishSnapshot();
                     }
                     conn->send("{\"ok\":true}\n");
                     broadcastSnapshot();
@@ -418,6 +1338,9 @@ int main(int argc, char** argv) {
                     else if (cmd == "reset") {
                         std::lock_guard<std::mutex> engLock(engineMutex);
                         engine.loadFromJson(json);
+                        engine.publishSnapshot();
+                        refreshInputHandles();
+                        refreshSubscriptions();
                         conn->send("{\"ok\":true}\n");
                     }
                     else if (cmd == "step_eval") {
@@ -436,19 +1359,95 @@ int main(int argc, char** argv) {
                     else if (cmd == "set_rate") { int hz = (int)getNum("hz"); fixedRateHz = std::max(0, hz); conn->send("{\"ok\":true}\n"); }
                     else if (cmd == "set_clock") { auto c = getStr("clock"); if (c=="wall"||c=="virtual") { clockType = c; conn->send("{\"ok\":true}\n"); } else conn->send("{\"ok\":false}\n"); }
                     else if (cmd == "set_time_scale") { double sc = getNum("scale"); if (sc < 0) sc = 0; timeScale = sc; conn->send("{\"ok\":true}\n"); }
+                    else if (cmd == "clients") {
+                        // Per-connection flow control state (lag and drop counters)
+                        const auto nowC = std::chrono::steady_clock::now();
+                        std::string s = "{\"type\":\"clients\",\"clients\":[";
+                        {
+                            std::lock_guard<std::mutex> lock(wsClientsMutex);
+                            bool first = true;
+                            for (const auto &kv : wsClients) {
+                                const WsClient &cl = kv.second;
+                                const long long lagMs = cl.behind ? std::chrono::duration_cast<std::chrono::milliseconds>(nowC - cl.behindSince).count() : 0;
+                                s += fmt::format("{}{{\"id\":{},\"format\":\"{}\",\"ports\":{},\"queuedBytes\":{},\"queuedMsgs\":{},\"maxQueuedBytes\":{},\"behind\":{},\"lagMs\":{},\"backlog\":{},\"sent\":{},\"dropped\":{},\"resyncs\":{}}}",
+                                                 first ? "" : ",", cl.id, cl.binary ? "binary" : "json", cl.sub ? static_cast<long long>(cl.sub->handles.size()) : -1LL,
+                                                 cl.flow->queuedBytes.load(), cl.flow->queuedMsgs.load(), cl.maxQueuedBytes, cl.behind ? "true" : "false", lagMs,
+                                                 cl.backlogText.size() + cl.backlogBinary.size(), cl.sentMsgs, cl.dropped, cl.resyncs);
+                                first = false;
+                            }
+                        }
+                        s += "]}\n";
+                        conn->send(s);
+                    }
                     else if (cmd == "status") {
                         std::string s = std::string("{\"type\":\"status\",\"mode\":\"") + (paused?"paused":"running") + "\",";
                         s += "\"clock\":\"" + clockType + "\",\"time_scale\":" + fmt::format("{:.3f}", timeScale) + ",\"rate_hz\":" + std::to_string(fixedRateHz) + ",\"eval_gen\":" + std::to_string((long long)engine.currentEvalGeneration()) + "}\n";
                         conn->send(s);
                     }
                     else { conn->send("{\"ok\":false}\n"); }
+                    engine.wake(); // pause/rate/clock changes move the loop's deadlines
+                } else if (type == "add_node" || type == "remove_node" || type == "connect" || type == "disconnect") {
+                    // Graph edits are applied in place (no reload); node state and handles survive
+                    const nlohmann::json cmd = nlohmann::json::parse(data);
+                    try {
+                        std::lock_guard<std::mutex> engLock(engineMutex);
+                        if (type == "add_node") engine.addNode(cmd.at("node"));
+                        else if (type == "remove_node") engine.removeNode(cmd.at("node").get<std::string>());
+                        else {
+                            NodeFlow::Connection c{cmd.at("fromNode").get<std::string>(), cmd.at("fromPort").get<std::string>(),
+                                                   cmd.at("toNode").get<std::string>(), cmd.at("toPort").get<std::string>()};
+                            if (type == "connect") engine.connect(c);
+                            else engine.disconnect(c);
+                        }
+                        engine.publishSnapshot();
+                        refreshInputHandles();
+                        refreshSubscriptions();
+                        engine.wake();
+                    } catch (const std::exception &e) {
+                        conn->send(nlohmann::json{{"ok", false}, {"err", e.what()}}.dump() + "\n");
+                        return;
+                    }
+                    conn->send("{\"ok\":true}\n");
+                    // Clients rebuild their handle maps from the new schema
+                    std::string schema;
+                    {
+                        std::lock_guard<std::mutex> engLock(engineMutex);
+                        schema = buildSchema();
+                    }
+                    auto it_ep = wsServer->endpoint.find(wsRegex);
+                    if (it_ep != wsServer->endpoint.end()) {
+                        const auto frame = makeFrame(schema);
+                        for (auto &c2 : it_ep->second.get_connections()) c2->send(frame);
+                    }
+                    broadcastSnapshot();
                 } else if (type == "reload") {
                     auto path = getStr("flow");
                     std::ifstream f(path);
-                    if (f.good()) { nlohmann::json j; f >> j; { std::lock_guard<std::mutex> engLock5(engineMutex); engine.loadFromJson(j); } conn->send("{\"ok\":true}\n"); broadcastSnapshot(); }
+                    if (f.good()) { nlohmann::json j; f >> j; { std::lock_guard<std::mutex> engLock5(engineMutex); engine.loadFromJson(j); engine.publishSnapshot(); refreshInputHandles(); } refreshSubscriptions(); engine.wake(); conn->send("{\"ok\":true}\n"); broadcastSnapshot(); }
                     else conn->send("{\"ok\":false}\n");
                 } else if (type == "subscribe") {
-                    conn->send("{\"ok\":true}\n");
+                    // Replaces the connection's subscription: "format" json (default)
+                    // or binary (see NodeFlowWire.hpp); "handles", "nodes" and
+                    // "patterns" filter ports, none of them means every port
+                    const nlohmann::json cmd = nlohmann::json::parse(data);
+                    const std::string format = cmd.value("format", std::string("json"));
+                    if (format != "json" && format != "binary") {
+                        conn->send("{\"ok\":false,\"err\":\"unknown format\"}\n");
+                        return;
+                    }
+                    SubscriptionSpec spec;
+                    if (cmd.contains("handles")) spec.handles = cmd.at("handles").get<std::vector<NodeFlow::PortHandle>>();
+                    if (cmd.contains("nodes")) spec.nodes = cmd.at("nodes").get<std::vector<std::string>>();
+                    if (cmd.contains("patterns")) spec.patterns = cmd.at("patterns").get<std::vector<std::string>>();
+                    spec.all = !cmd.contains("handles") && !cmd.contains("nodes") && !cmd.contains("patterns");
+                    const bool binary = format == "binary";
+                    const size_t watched = subscribeClient(conn.get(), binary, std::move(spec));
+                    conn->send(fmt::format("{{\"ok\":true,\"format\":\"{}\",\"ports\":{}}}\n", format, watched));
+                    // Baseline for the new subscription; deltas follow
+                    const auto sub = clientSubscription(conn.get());
+                    const auto snap = encodeSnapshot(*engine.getSnapshot(), sub.get(), binary);
+                    if (binary) conn->send(snap, nullptr, NodeFlow::Wire::kBinaryOpcode);
+                    else conn->send(snap);
                 } else {
                     conn->send("{\"ok\":false,\"err\":\"unknown type\"}\n");
                 }
@@ -458,6 +1457,7 @@ int main(int argc, char** argv) {
         };
 
         ep.on_open = [&](auto conn){
+            registerClient(conn.get());
             std::lock_guard<std::mutex> lock(wsMutex);
             try {
                 auto schema = buildSchema();
@@ -468,140 +1468,541 @@ int main(int argc, char** argv) {
                     // Ensure at least one execute so initial values/params propagate
                     engine.execute();
                 }
-                auto snap = buildSnapshot();
+                auto snap = share(encodeSnapshot(*engine.getSnapshot(), nullptr, false));
                 latestJson = snap;
-                conn->send(snap);
+                conn->send(*snap);
             } catch(...) {}
             fmt::print("client connected\n");
         };
-        ep.on_close = [&](auto /*conn*/, int /*status*/, const std::string& /*reason*/){ fmt::print("client disconnected\n"); };
+        ep.on_close = [&](auto conn, int /*status*/, const std::string& /*reason*/){ unregisterClient(conn.get()); fmt::print("client disconnected\n"); };
+        ep.on_error = [&](auto conn, const SimpleWeb::error_code& /*ec*/){ unregisterClient(conn.get()); };
 
         wsThread = std::thread([&]{ wsServer->start(); });
     }
 
-    // Main loop: Run flow and broadcast generic snapshots and deltas
+    // Main loop: Run flow and broadcast generic snapshots and deltas. The loop
+    // blocks until something is due (queued input, a Timer, a delta flush,
+    // heartbeat or periodic snapshot) instead of polling, so input-to-output
+    // latency is bounded by eval time rather than a sleep quantum. --spin
+    // busy-polls instead and moves client work to another thread.
     NodeFlow::Generation lastSnapshotGen = 0;
     using Steady = std::chrono::steady_clock;
+    // The old polling period: virtual clock step cadence and Timer pulse width
+    constexpr double kLoopQuantumMs = 10.0;
+    auto afterMs = [](Steady::time_point t, double ms) {
+        return t + std::chrono::duration_cast<Steady::duration>(std::chrono::duration<double, std::milli>(ms));
+    };
     auto lastTs = Steady::now();
+    auto nextVirtualStep = lastTs;
     auto lastFullSnapshot = Steady::now();
-    while (running) {
-        auto nowTs = Steady::now();
-        double dtMs = (double)std::chrono::duration_cast<std::chrono::milliseconds>(nowTs - lastTs).count();
-        if (clockType == "virtual") {
-            if (fixedRateHz > 0) dtMs = 1000.0 / std::max(1, fixedRateHz);
-            else dtMs = 16.667;
-        }
-        dtMs *= timeScale;
-        lastTs = nowTs;
-        // Track dt for timing envelope
-        // Note: buildT captures this by value when composing messages
-        (void)lastDtMsObserved; // keep var used when --ws-time enabled
-        lastDtMsObserved = dtMs;
-        if (!paused && dtMs > 0.0) engine.tick(dtMs);
-        if (!paused) engine.execute();
-        auto valueToJsonLoop = [](const NodeFlow::Value &v) -> std::string {
-            if (std::holds_alternative<float>(v)) return jsonNumberForDtype("float", (double)std::get<float>(v), 3);
-            if (std::holds_alternative<double>(v)) return jsonNumberForDtype("double", (double)std::get<double>(v), 3);
-            if (std::holds_alternative<int>(v)) return jsonNumberForDtype("int", (double)std::get<int>(v), 3);
-            if (std::holds_alternative<std::string>(v)) {
-                const auto &s = std::get<std::string>(v);
-                std::string esc; esc.reserve(s.size()+2);
-                esc.push_back('"');
-                for (char c : s) { if (c=='"' || c=='\\') esc.push_back('\\'); esc.push_back(c);} 
-                esc.push_back('"');
-                return esc;
-            }
-            return "null";
-        };
+    // Runtime perf summaries (--perf-out): eval cost, wakeups and the
+    // input-to-output latency distribution
+    FILE* runtimePerfFp = perfOut.empty() ? nullptr : std::fopen(perfOut.c_str(), "w");
+    auto lastPerf = Steady::now();
+    unsigned long long wakeInput = 0, wakeDeadline = 0;
+
+    // WS side of the loop: periodic snapshot, delta aggregation and flush,
+    // heartbeat and perf lines. Runs on the engine thread, or on its own
+    // thread with --spin so serialization never lands on the engine's core.
+    // Per-client flow control: flush the backlog of clients that caught up
+    // (one merged delta, or a snapshot when resync is due) and turn the
+    // backlog of clients lagging past --ws-client-resync-ms into a resync
+    auto serviceBacklogs = [&]() {
+        auto it_ep = wsServer->endpoint.find(wsRegex);
+        if (it_ep == wsServer->endpoint.end()) return;
+        const auto now = Steady::now();
+        std::shared_ptr<const NodeFlow::FlowEngine::PortSnapshot> view;
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &c : it_ep->second.get_connections()) {
+            auto itc = wsClients.find(c.get());
+            if (itc == wsClients.end()) continue;
+            WsClient &cl = itc->second;
+            if (isBehind(cl)) {
+                if (!cl.behind) { cl.behind = true; cl.behindSince = now; }
+                if (!cl.needResync && cl.hasBacklog() && now - cl.behindSince >= std::chrono::milliseconds(wsClientResyncMs)) resyncLater(cl);
+                continue;
+            }
+            cl.behind = false;
+            if (!cl.hasBacklog()) continue;
+            if (!view) view = engine.getSnapshot();
+            if (cl.needResync) {
+                sendTracked(c, cl, makeFrame(encodeSnapshot(*view, cl.sub.get(), cl.binary)), cl.binary);
+                ++cl.resyncs;
+                ++wsResyncTotal;
+            } else if (cl.binary) {
+                NodeFlow::Wire::FrameWriter w;
+                w.begin(NodeFlow::Wire::Kind::Delta, ++wireSeq, view->generation);
+                for (const auto &kv : cl.backlogBinary) addBinaryValue(w, kv.first, kv.second);
+                sendTracked(c, cl, makeFrame(w.finish()), true);
+            } else {
+                std::string delta = "{\"type\":\"delta\"";
+                delta += buildT();
+                for (const auto &kv : cl.backlogText) delta += ",\"" + kv.second.first + "\":" + kv.second.second;
+                delta += "}\n";
+                sendTracked(c, cl, makeFrame(delta), false);
+            }
+            cl.clearBacklog();
+            cl.needResync = false;
+        }
+    };
 
+    auto serviceClients = [&]() {
+        if (wsServer) serviceBacklogs();
         // Periodic full snapshot (optional)
         if (wsServer && wsSnapshotIntervalSec > 0 && std::chrono::duration_cast<std::chrono::seconds>(Steady::now() - lastFullSnapshot).count() >= wsSnapshotIntervalSec) {
-            std::string jsonOut = "{\"type\":\"snapshot\"";
-            jsonOut += buildT();
-            const auto &portsOut = engine.getPortDescs();
-            std::unordered_map<std::string,int> outCount2;
-            for (const auto &p : portsOut) if (p.direction == "output") ++outCount2[p.nodeId];
-            for (const auto &p : portsOut) {
-                if (p.direction != "output") continue;
-                auto v = engine.readPort(p.handle);
-                jsonOut += ",\""; jsonOut += p.nodeId; jsonOut += ":"; jsonOut += p.portId; jsonOut += "\":";
-                jsonOut += valueToJsonLoop(v);
-            }
-            jsonOut += "}\n";
-            {
-                std::lock_guard<std::mutex> lock(wsMutex);
-                latestJson = jsonOut;
-            }
-            auto endpoint_it = wsServer->endpoint.find(wsRegex);
-            if (endpoint_it != wsServer->endpoint.end()) for (auto &conn : endpoint_it->second.get_connections()) conn->send(jsonOut);
+            fanOutSnapshot();
             lastFullSnapshot = Steady::now();
         }
 
-        // Delta aggregation using evaluation generation counters (per-port)
-        auto curEvalGen = engine.currentEvalGeneration();
-        auto deltas = engine.getPortDeltasChangedSince(lastSnapshotGen);
-        if (!deltas.empty()) {
-            for (const auto &t : deltas) {
-                const auto &nodeId = std::get<0>(t);
-                const auto &portId = std::get<1>(t);
-                const auto &val = std::get<2>(t);
-                // Build canonical key and formatted value
-                std::string key = nodeId + ":" + portId;
-                std::string v = valueToJsonLoop(val);
-                // Optional epsilon suppression for floats
-                if (wsDeltaEpsilon > 0.0) {
-                    try {
-                        double dv = std::stod(v);
-                        auto itPrev = pendingDelta.find(key);
-                        if (itPrev != pendingDelta.end()) {
-                            double pv = std::stod(itPrev->second);
-                            if (std::abs(dv - pv) < wsDeltaEpsilon) continue;
-                        }
-                    } catch(...) {}
-                }
-                pendingDelta[key] = v;
-            }
-            lastActivity = std::chrono::steady_clock::now();
+        // Delta aggregation using evaluation generation counters (per-port),
+        // limited to ports some client watches
+        std::shared_ptr<const Subscription> watched;
+        {
+            std::lock_guard<std::mutex> lock(wsClientsMutex);
+            watched = watchedPorts;
         }
+        NodeFlow::Generation curEvalGen;
+        bool anyChange = false;
+        {
+            std::lock_guard<std::mutex> engLock(engineMutex);
+            curEvalGen = engine.currentEvalGeneration();
+            pendingDelta.layout(engine.getSnapshot()->descs);
+            engine.forEachPortChangedSince(lastSnapshotGen, [&](NodeFlow::PortHandle h) {
+                if (watched && !watched->has(h)) return;
+                pendingDelta.record(h, engine.readPort(h), wsDeltaEpsilon);
+                anyChange = true;
+            });
+        }
+        if (anyChange) lastActivity = std::chrono::steady_clock::now();
         // Advance watermark to current evaluation generation
         lastSnapshotGen = curEvalGen;
 
         // Flush window / heartbeat
         auto now = std::chrono::steady_clock::now();
-        bool timeToFlush = (wsDeltaRateHz == 0) ? !pendingDelta.empty() : (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastFlush).count() >= (1000 / std::max(1, wsDeltaRateHz)));
-        if (wsServer && timeToFlush && !pendingDelta.empty()) {
-            int count = 0;
-            std::string delta = "{\"type\":\"delta\"";
-            delta += buildT();
-            for (const auto &kv : pendingDelta) {
-                if (count >= wsDeltaMaxBatch) break;
-                delta += ",\"" + kv.first + "\":" + kv.second;
-                ++count;
-            }
-            delta += "}\n";
-            auto endpoint_it2 = wsServer->endpoint.find(wsRegex);
-            if (endpoint_it2 != wsServer->endpoint.end()) {
-                auto &endpoint2 = endpoint_it2->second;
-                for (auto &conn : endpoint2.get_connections()) conn->send(delta);
-            }
-            pendingDelta.clear();
+        const bool deltaPending = !pendingDelta.empty();
+        bool timeToFlush = (wsDeltaRateHz == 0) ? deltaPending : (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastFlush).count() >= (1000 / std::max(1, wsDeltaRateHz)));
+        if (wsServer && timeToFlush && deltaPending) {
+            // Visit the pending handles a subscription watches, iterating
+            // whichever side is smaller
+            auto forEachWatched = [&](const Subscription* sub, auto &&f) {
+                const auto &changed = pendingDelta.changed();
+                if (!sub || changed.size() <= sub->handles.size()) {
+                    for (auto h : changed) if (pendingDelta.pending(h) && (!sub || sub->has(h))) if (!f(h)) return;
+                    return;
+                }
+                for (auto h : sub->handles) if (pendingDelta.pending(h) && !f(h)) return;
+            };
+            fanOut([&](const Subscription* sub, bool binary) -> Payload {
+                if (binary) {
+                    deltaFrame.begin(NodeFlow::Wire::Kind::Delta, 0, curEvalGen);
+                    forEachWatched(sub, [&](NodeFlow::PortHandle h) {
+                        pendingDelta.addBinary(deltaFrame, h);
+                        return static_cast<int>(deltaFrame.records()) < wsDeltaMaxBatch;
+                    });
+                    if (deltaFrame.records() == 0) return {};
+                    // Sequence numbers only go to frames that are sent
+                    deltaFrame.setSequence(++wireSeq);
+                    return share(std::string(deltaFrame.finish()));
+                }
+                int count = 0;
+                deltaText.assign("{\"type\":\"delta\"");
+                deltaText += buildT();
+                forEachWatched(sub, [&](NodeFlow::PortHandle h) {
+                    pendingDelta.appendJson(deltaText, h);
+                    return ++count < wsDeltaMaxBatch;
+                });
+                if (count == 0) return {};
+                deltaText += "}\n";
+                return share(std::string(deltaText));
+            }, [&](WsClient &cl) {
+                bool merged = false;
+                forEachWatched(cl.sub.get(), [&](NodeFlow::PortHandle h) {
+                    merged = true;
+                    if (cl.needResync) return true;
+                    if (cl.binary) cl.backlogBinary[h] = pendingDelta.value(h);
+                    else cl.backlogText[h] = {pendingDelta.key(h), pendingDelta.json(h)};
+                    return true;
+                });
+                return merged;
+            });
+            pendingDelta.markSent();
             lastFlush = now;
             lastActivity = now;
         } else if (wsServer && wsHeartbeatSec > 0 && std::chrono::duration_cast<std::chrono::seconds>(now - lastActivity).count() >= wsHeartbeatSec) {
             auto endpoint_it2 = wsServer->endpoint.find(wsRegex);
             if (endpoint_it2 != wsServer->endpoint.end()) {
-                for (auto &conn : endpoint_it2->second.get_connections()) conn->send("{\"type\":\"heartbeat\"}\n");
+                const auto frame = makeFrame("{\"type\":\"heartbeat\"}\n");
+                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                for (auto &conn : endpoint_it2->second.get_connections()) {
+                    auto itc = wsClients.find(conn.get());
+                    if (itc != wsClients.end() && isBehind(itc->second)) continue; // still busy, not idle
+                    conn->send(frame);
+                }
             }
             lastActivity = now;
         }
 
-        // Small delay to prevent CPU overuse
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (runtimePerfFp && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastPerf).count() >= perfIntervalMs) {
+            NodeFlow::FlowEngine::PerfStats ps;
+            {
+                std::lock_guard<std::mutex> engLock(engineMutex);
+                ps = engine.getAndResetPerfStats();
+            }
+            unsigned long long samples = 0;
+            for (unsigned long long c : ps.inputLatencyHist) samples += c;
+            int clientsBehind = 0;
+            {
+                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                for (const auto &kv : wsClients) clientsBehind += kv.second.behind ? 1 : 0;
+            }
+            std::fprintf(runtimePerfFp,
+                "{\"type\":\"runtime\",\"mode\":\"%s\",\"evalCount\":%llu,\"evalTimeNsAccum\":%llu,\"evalTimeNsMax\":%llu,\"nodesEvaluated\":%llu,\"wakeInput\":%llu,\"wakeDeadline\":%llu,\"inputsDrained\":%llu,\"inputsCoalesced\":%llu,\"inputsDropped\":%llu,\"latencySamples\":%llu,\"latencyP50Ns\":%llu,\"latencyP90Ns\":%llu,\"latencyP99Ns\":%llu,\"latencyP999Ns\":%llu,\"latencyMaxNs\":%llu,\"wsClientsBehind\":%d,\"wsDropped\":%llu,\"wsResyncs\":%llu}\n",
+                spin ? "spin" : "event", ps.evalCount, ps.evalTimeNsAccum, ps.evalTimeNsMax, ps.nodesEvaluated, wakeInput, wakeDeadline,
+                ps.inputsDrained, ps.inputsCoalesced, ps.inputsDropped, samples,
+                ps.latencyPercentile(0.50), ps.latencyPercentile(0.90), ps.latencyPercentile(0.99),
+                ps.latencyPercentile(0.999), ps.latencyPercentile(1.0),
+                clientsBehind, wsDroppedTotal.exchange(0), wsResyncTotal.exchange(0));
+            std::fflush(runtimePerfFp);
+            wakeInput = wakeDeadline = 0;
+            lastPerf = now;
+        }
+    };
+
+    // Earliest time serviceClients() has something to do (at most `cap`)
+    auto clientDeadline = [&](Steady::time_point cap) {
+        auto deadline = cap;
+        if (wsServer && !pendingDelta.empty() && wsDeltaRateHz > 0) deadline = std::min(deadline, afterMs(lastFlush, 1000.0 / wsDeltaRateHz));
+        if (wsServer && wsHeartbeatSec > 0) deadline = std::min(deadline, lastActivity + std::chrono::seconds(wsHeartbeatSec));
+        if (wsServer && wsSnapshotIntervalSec > 0) deadline = std::min(deadline, lastFullSnapshot + std::chrono::seconds(wsSnapshotIntervalSec));
+        if (runtimePerfFp) deadline = std::min(deadline, afterMs(lastPerf, perfIntervalMs));
+        return deadline;
+    };
+
+    // WS fan-out benchmark (--bench with --bench-ws-clients): for each client
+    // count, connect that many local clients and broadcast the flow's snapshot
+    // at --bench-rate (default 100 Hz), once copying the payload into every
+    // connection ("copy", the old send path) and once sharing one frame
+    // ("shared"). Send CPU is this thread's fan-out plus the WS server thread.
+    // --bench-shm-out compares --shm-out readers with WS clients instead.
+    if (bench) {
+        using namespace std::chrono;
+        using WsBenchClient = SimpleWeb::SocketClient<SimpleWeb::WS>;
+        using IoContext = decltype(WsBenchClient::io_service)::element_type;
+        FILE* perfFp = perfOut.empty() ? nullptr : std::fopen(perfOut.c_str(), "w");
+#if defined(__linux__)
+        // Every local client costs two descriptors
+        rlimit nofile{};
+        if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nofile.rlim_max) {
+            nofile.rlim_cur = nofile.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &nofile);
+        }
+#endif
+        auto cpuNs = [](clockid_t id) {
+            timespec ts{};
+            clock_gettime(id, &ts);
+            return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ull + static_cast<unsigned long long>(ts.tv_nsec);
+        };
+        bool haveWsCpu = false;
+        clockid_t wsCpu{};
+#if defined(__linux__)
+        haveWsCpu = pthread_getcpuclockid(wsThread.native_handle(), &wsCpu) == 0;
+#endif
+        auto registeredClients = [&]() {
+            std::lock_guard<std::mutex> lock(wsClientsMutex);
+            return wsClients.size();
+        };
+        // Wait until the server has written everything it queued
+        auto waitDrained = [&]() {
+            const auto until = steady_clock::now() + seconds(5);
+            for (;;) {
+                bool drained = true;
+                {
+                    std::lock_guard<std::mutex> lock(wsClientsMutex);
+                    for (const auto &kv : wsClients) drained = drained && kv.second.flow->queuedBytes.load() == 0 && !kv.second.hasBacklog();
+                }
+                if (drained || steady_clock::now() >= until) return;
+                serviceBacklogs();
+                std::this_thread::sleep_for(milliseconds(1));
+            }
+        };
+        const int rateHz = (benchRate > 0) ? benchRate : 100;
+        const int each = (benchDuration > 0) ? benchDuration : 2;
+        const auto tick = duration_cast<steady_clock::duration>(duration<double>(1.0 / rateHz));
+        const size_t payloadBytes = encodeSnapshot(*engine.getSnapshot(), nullptr, false).size();
+        const std::string url = fmt::format("localhost:{}{}", wsPort, wsPath);
+        const unsigned ioThreadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+        if (benchShmOut) {
+            // Set-to-observed latency of one output change at --bench-rate:
+            // a thread polling the --shm-out mirror, as a co-located reader
+            // would, vs a local WS client receiving the JSON delta. The delta
+            // is flushed right after the eval (the WS best case, rate 0).
+            std::string trigger;
+            for (const auto &nd : engine.getNodeDescs()) if (nd.type == "DeviceTrigger" && !nd.removed) { trigger = nd.id; break; }
+            nodeflow_shm_out reader{};
+            if (trigger.empty() || nodeflow_shm_out_open(&reader, shmMirror.name().c_str()) != 0) {
+                fmt::print("bench[shm-out]: needs a DeviceTrigger and a readable mirror\n");
+                return 1;
+            }
+            if (runtimePerfFp) { std::fclose(runtimePerfFp); runtimePerfFp = nullptr; } // perf lines are ours here
+            auto nowNs = [] { return static_cast<long long>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count()); };
+            std::atomic<bool> armed{false};
+            std::atomic<long long> shmSeenNs{0}, wsSeenNs{0};
+            auto observed = [&](std::atomic<long long> &at) {
+                long long none = 0;
+                if (armed.load(std::memory_order_acquire)) at.compare_exchange_strong(none, nowNs());
+            };
+            std::atomic<bool> polling{true};
+            std::thread poller([&] {
+                uint64_t seen = nodeflow_shm_out_seq(&reader);
+                while (polling.load(std::memory_order_relaxed)) {
+                    if (nodeflow_shm_out_seq(&reader) == seen) { cpuRelax(); continue; }
+                    nodeflow_shm_out_read(&reader, nullptr, nullptr, nullptr, &seen);
+                    observed(shmSeenNs);
+                }
+            });
+            auto io = std::make_shared<IoContext>();
+            auto client = std::make_unique<WsBenchClient>(url);
+            client->io_service = io;
+            client->on_message = [&](std::shared_ptr<WsBenchClient::Connection>, std::shared_ptr<WsBenchClient::InMessage> msg) {
+                if (msg->string().compare(0, 15, "{\"type\":\"delta\"") == 0) observed(wsSeenNs);
+            };
+            client->start();
+            std::thread ioThread([io] { io->run(); });
+            const auto connectBy = steady_clock::now() + seconds(10);
+            while (registeredClients() < 1 && steady_clock::now() < connectBy) std::this_thread::sleep_for(milliseconds(10));
+            waitDrained();
+            const int savedDeltaRate = wsDeltaRateHz;
+            wsDeltaRateHz = 0;
+            std::vector<long long> shmLat, wsLat;
+            unsigned long long rounds = 0;
+            auto next = steady_clock::now();
+            const auto endAt = next + seconds(each);
+            for (float v = 1.0f; next < endAt; v = 1.0f - v) {
+                shmSeenNs = 0;
+                wsSeenNs = 0;
+                armed.store(true, std::memory_order_release);
+                const long long t0 = nowNs();
+                {
+                    std::lock_guard<std::mutex> engLock(engineMutex);
+                    engine.setNodeValue(trigger, v);
+                    engine.execute();
+                    shmMirror.publish(engine);
+                }
+                serviceClients(); // what the event loop does after an eval
+                const auto giveUp = steady_clock::now() + milliseconds(200);
+                while ((shmSeenNs.load() == 0 || wsSeenNs.load() == 0) && steady_clock::now() < giveUp) std::this_thread::yield();
+                armed = false;
+                if (shmSeenNs.load()) shmLat.push_back(shmSeenNs.load() - t0);
+                if (wsSeenNs.load()) wsLat.push_back(wsSeenNs.load() - t0);
+                ++rounds;
+                next += tick;
+                std::this_thread::sleep_until(next);
+            }
+            wsDeltaRateHz = savedDeltaRate;
+            polling = false;
+            poller.join();
+            io->stop();
+            ioThread.join();
+            client.reset();
+            nodeflow_shm_out_close(&reader);
+            for (auto *lat : {&shmLat, &wsLat}) {
+                const char* mode = lat == &shmLat ? "shm" : "ws";
+                std::sort(lat->begin(), lat->end());
+                auto pct = [&](double q) { return lat->empty() ? 0ll : (*lat)[std::min(lat->size() - 1, static_cast<size_t>(q * static_cast<double>(lat->size())))]; };
+                fmt::print("bench[shm-out/{}]: rounds={} observed={} latencyNs p50={} p99={} max={}\n", mode, rounds, lat->size(), pct(0.50), pct(0.99),
+                           lat->empty() ? 0ll : lat->back());
+                if (perfFp) {
+                    std::fprintf(perfFp, "{\"type\":\"shm_out\",\"mode\":\"%s\",\"rateHz\":%d,\"rounds\":%llu,\"observed\":%zu,\"latencyNsP50\":%lld,\"latencyNsP99\":%lld,\"latencyNsMax\":%lld}\n",
+                                 mode, rateHz, rounds, lat->size(), pct(0.50), pct(0.99), lat->empty() ? 0ll : lat->back());
+                    std::fflush(perfFp);
+                }
+            }
+        }
+        for (int n : benchWsClients) {
+            if (n <= 0) continue;
+            auto io = std::make_shared<IoContext>();
+            std::atomic<unsigned long long> received{0};
+            std::vector<std::unique_ptr<WsBenchClient>> clients;
+            for (int i = 0; i < n; ++i) {
+                auto client = std::make_unique<WsBenchClient>(url);
+                client->io_service = io; // start() only connects; the threads below run it
+                client->on_message = [&received](std::shared_ptr<WsBenchClient::Connection>, std::shared_ptr<WsBenchClient::InMessage>) { ++received; };
+                client->start();
+                clients.push_back(std::move(client));
+            }
+            std::vector<std::thread> ioThreads;
+            for (unsigned t = 0; t < ioThreadCount; ++t) ioThreads.emplace_back([io] { io->run(); });
+            const auto connectBy = steady_clock::now() + seconds(10);
+            while (registeredClients() < static_cast<size_t>(n) && steady_clock::now() < connectBy) std::this_thread::sleep_for(milliseconds(10));
+            const size_t connected = registeredClients();
+            for (bool copy : {true, false}) {
+                const char* mode = copy ? "copy" : "shared";
+                waitDrained(); // schema and connect snapshots, or the previous mode
+                wsCopyPerClient = copy;
+                received = 0;
+                wsDroppedTotal = 0;
+                const auto fan0 = cpuNs(CLOCK_THREAD_CPUTIME_ID);
+                const auto ws0 = haveWsCpu ? cpuNs(wsCpu) : 0;
+                unsigned long long broadcasts = 0;
+                auto next = steady_clock::now();
+                const auto endAt = next + seconds(each);
+                while (next < endAt) {
+                    serviceBacklogs();
+                    fanOutSnapshot();
+                    ++broadcasts;
+                    next += tick;
+                    std::this_thread::sleep_until(next);
+                }
+                waitDrained();
+                const auto fanNs = cpuNs(CLOCK_THREAD_CPUTIME_ID) - fan0;
+                const auto wsNs = haveWsCpu ? cpuNs(wsCpu) - ws0 : 0;
+                const double perBroadcast = broadcasts ? static_cast<double>(fanNs + wsNs) / static_cast<double>(broadcasts) : 0.0;
+                const double perSend = connected ? perBroadcast / static_cast<double>(connected) : 0.0;
+                fmt::print("bench[ws/{}]: clients={} broadcasts={} payloadBytes={} sendCpuNsPerBroadcast={:.0f} sendCpuNsPerClient={:.1f} delivered={} dropped={}\n",
+                           mode, connected, broadcasts, payloadBytes, perBroadcast, perSend, received.load(), wsDroppedTotal.load());
+                if (perfFp) {
+                    std::fprintf(perfFp,
+                        "{\"type\":\"ws_fanout\",\"mode\":\"%s\",\"clients\":%zu,\"rateHz\":%d,\"broadcasts\":%llu,\"payloadBytes\":%zu,\"fanOutCpuNs\":%llu,\"wsThreadCpuNs\":%llu,\"sendCpuNsPerBroadcast\":%.0f,\"sendCpuNsPerClient\":%.1f,\"delivered\":%llu,\"dropped\":%llu}\n",
+                        mode, connected, rateHz, broadcasts, payloadBytes, fanNs, wsNs, perBroadcast, perSend, received.load(), wsDroppedTotal.load());
+                    std::fflush(perfFp);
+                }
+            }
+            wsCopyPerClient = false;
+            io->stop();
+            for (auto &t : ioThreads) t.join();
+            clients.clear();
+            io.reset();
+            // The server drops the connections before the next count connects
+            const auto closeBy = steady_clock::now() + seconds(5);
+            while (registeredClients() > 0 && steady_clock::now() < closeBy) std::this_thread::sleep_for(milliseconds(10));
+        }
+        if (perfFp) std::fclose(perfFp);
+        wsServer->stop();
+        if (wsThread.joinable()) wsThread.join();
+        return 0;
+    }
+
+    if (spin) {
+        // Busy-poll mode: the engine thread never blocks. It ticks when a Timer
+        // is due (or a pulse has lasted one quantum) and executes as soon as
+        // an input is queued or nodes are scheduled. Client work polls from
+        // its own thread at the delta flush rate.
+        std::thread clientThread([&] {
+            while (running) {
+                serviceClients();
+                const auto now = Steady::now();
+                const double pollMs = (wsDeltaRateHz > 0) ? 1000.0 / wsDeltaRateHz : 1.0;
+                std::this_thread::sleep_until(clientDeadline(afterMs(now, pollMs)));
+            }
+        });
+        if (spinCore >= 0) {
+            if (!pinCurrentThread(spinCore)) fmt::print("spin: could not pin engine thread to core {}\n", spinCore);
+            keepThreadOffCore(clientThread, spinCore);
+            if (wsThread.joinable()) keepThreadOffCore(wsThread, spinCore);
+        }
+        double pendingDtMs = 0.0;
+        while (running) {
+            const auto nowTs = Steady::now();
+            if (clockType == "virtual") {
+                if (nowTs >= nextVirtualStep) {
+                    pendingDtMs += (fixedRateHz > 0) ? 1000.0 / std::max(1, fixedRateHz) : 16.667;
+                    nextVirtualStep = afterMs(nowTs, kLoopQuantumMs);
+                }
+            } else {
+                pendingDtMs += std::chrono::duration<double, std::milli>(nowTs - lastTs).count() * timeScale;
+            }
+            lastTs = nowTs;
+            {
+                std::lock_guard<std::mutex> engLock(engineMutex);
+                if (!paused) {
+                    const bool tickDue = pendingDtMs >= engine.nextTimerDueMs()
+                                      || (engine.timerPulseActive() && pendingDtMs >= kLoopQuantumMs * timeScale)
+                                      || clockType == "virtual";
+                    if (tickDue && pendingDtMs > 0.0) {
+                        engine.tick(pendingDtMs);
+                        lastDtMsObserved.store(pendingDtMs, std::memory_order_relaxed);
+                        pendingDtMs = 0.0;
+                    }
+                    if (engine.hasPendingWork()) engine.execute();
+                } else {
+                    pendingDtMs = 0.0;
+                    if (engine.drainInputs() > 0) engine.publishSnapshot();
+                }
+                if (mirrorOn) shmMirror.publish(engine);
+            }
+            cpuRelax();
+        }
+        clientThread.join();
+    } else {
+        // Producers on the --shm-in ring cannot reach the engine's condvar:
+        // this thread sleeps on the ring's futex and turns pushes into wake()s.
+        // After a wake it stays off the futex until the engine has drained, so
+        // producers pay for a syscall at most once per eval.
+        std::thread shmWaker;
+        if (shmRing) {
+            shmWaker = std::thread([&] {
+                while (running) {
+                    if (!shmRing->waitForData(std::chrono::milliseconds(100))) continue;
+                    const auto seen = shmRing->consumed();
+                    engine.wake();
+                    while (running && shmRing->depth() > 0 && shmRing->consumed() == seen) std::this_thread::sleep_for(std::chrono::microseconds(20));
+                }
+            });
+        }
+        while (running) {
+            auto nowTs = Steady::now();
+            double dtMs = std::chrono::duration<double, std::milli>(nowTs - lastTs).count();
+            if (clockType == "virtual") {
+                // Fixed steps at the loop quantum, however often inputs wake us
+                dtMs = 0.0;
+                if (nowTs >= nextVirtualStep) {
+                    dtMs = (fixedRateHz > 0) ? 1000.0 / std::max(1, fixedRateHz) : 16.667;
+                    nextVirtualStep = afterMs(nowTs, kLoopQuantumMs);
+                }
+            }
+            dtMs *= timeScale;
+            lastTs = nowTs;
+            // Track dt for timing envelope
+            lastDtMsObserved.store(dtMs, std::memory_order_relaxed);
+            {
+                // Graph edits from the WS thread must not interleave with evaluation
+                std::lock_guard<std::mutex> engLock(engineMutex);
+                if (!paused && dtMs > 0.0) engine.tick(dtMs);
+                if (!paused) engine.execute();
+                else { engine.drainInputs(); engine.publishSnapshot(); } // inputs still land while paused
+                if (mirrorOn) shmMirror.publish(engine);
+            }
+            serviceClients();
+
+            // Sleep until the earliest deadline or the next queued input. The 1 s
+            // cap picks up settings the WS thread changed without calling wake().
+            const auto now = Steady::now();
+            auto deadline = clientDeadline(afterMs(now, 1000.0));
+            auto until = [&](Steady::time_point t) { if (t < deadline) deadline = t; };
+            if (!paused) {
+                if (clockType == "virtual") {
+                    until(nextVirtualStep);
+                } else {
+                    double dueMs;
+                    bool pulse;
+                    {
+                        std::lock_guard<std::mutex> engLock(engineMutex);
+                        dueMs = engine.nextTimerDueMs();
+                        pulse = engine.timerPulseActive();
+                    }
+                    if (pulse) until(afterMs(now, kLoopQuantumMs));
+                    if (timeScale > 0.0 && std::isfinite(dueMs)) until(afterMs(now, dueMs / timeScale));
+                }
+            }
+            if (engine.waitForInput(deadline)) ++wakeInput; else ++wakeDeadline;
+        }
+        if (shmWaker.joinable()) shmWaker.join();
     }
 
     // Cleanup
     
     running = false;
+    if (runtimePerfFp) std::fclose(runtimePerfFp);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,471 @@
+/* nodeflow_shm.h
+ *
+ * Shared memory between a NodeFlow runtime (or AOT host) and processes on the
+ * same host. C99 or C++ with GCC/Clang __atomic builtins and POSIX shm (link
+ * -lrt on glibc < 2.34); strict -std=c99 needs _GNU_SOURCE defined first for
+ * clock_gettime and syscall. Handles come from the WS schema; all fields are
+ * host byte order.
+ *
+ * Ingress (`--shm-in /name`): producers (device drivers) attach with
+ * nodeflow_shm_in_open() and push fixed-size records, which the engine drains
+ * at the start of every eval together with WS input (latest value per handle
+ * wins).
+ *
+ *   header  256 bytes: magic, version, capacity (cells, power of two),
+ *           record size; then the producer cursor, the consumer cursor and
+ *           the drop/wake words, each on its own cache line
+ *   cells   capacity x 32 bytes: u64 sequence + record
+ *
+ * Any number of producers: a push claims a slot by CAS on `head`, writes the
+ * record and publishes it by storing the slot's sequence (bounded MPSC ring,
+ * one sequence number per cell, like the engine's own input queue). A full
+ * ring rejects the push and counts it in `dropped`; producers never block.
+ *
+ *   nodeflow_shm_in ring;
+ *   if (nodeflow_shm_in_open(&ring, "/nodeflow-in") == 0) {
+ *       nodeflow_shm_in_push_float(&ring, handle, 0.5f);
+ *       nodeflow_shm_in_close(&ring);
+ *   }
+ *
+ * Timestamps are CLOCK_MONOTONIC ns (the runtime's steady clock on Linux) and
+ * feed its input latency stats; 0 means "now" at drain.
+ *
+ * Handles are only valid for the graph they came from. A reload discards the
+ * records queued in the ring at that moment, as it does for WS input, rather
+ * than applying them to whatever port now has that handle; producers should
+ * re-read the schema after a reload before pushing again.
+ *
+ * Egress (`--shm-out /name`): the runtime mirrors port values into a region
+ * indexed by port handle after every eval that changed an output. Readers
+ * map it read-only and poll it; nothing is serialized.
+ *
+ *   header  128 bytes: magic, version, slots (highest handle + 1), bitmap
+ *           words; then the seqlock word, the generation (publish count),
+ *           the writer's eval generation and the publish timestamp
+ *   descs   slots x 64 bytes: dtype, is_output, "node:port" (truncated)
+ *   values  slots x u64: the port's value in its dtype (int32 / float /
+ *           double in the low bytes, see nodeflow_shm_value); strings are
+ *           not mirrored
+ *   changed bitmap words x u64: bit h set if port h changed in this generation
+ *
+ * The writer bumps `seq` to odd, updates values and the bitmap, then bumps it
+ * back to even; a read is consistent if `seq` was even and unchanged around
+ * the copy (nodeflow_shm_out_read retries for you). The bitmap only covers
+ * the latest generation: a reader that sees the generation jump by more than
+ * one has missed bitmaps and should diff its copy of the values instead.
+ *
+ * The descs are not covered by the seqlock: nodeflow_shm_out_read copies
+ * values and the bitmap only. They are written by create/describe (at start
+ * and when a graph load or edit re-describes the slots) and are only stable
+ * between those; a reader that keeps names or dtypes across such a change
+ * must re-read them.
+ *
+ *   nodeflow_shm_out mirror;
+ *   uint64_t seen = 0;
+ *   if (nodeflow_shm_out_open(&mirror, "/nodeflow-out") == 0) {
+ *       for (;;) {
+ *           if (nodeflow_shm_out_seq(&mirror) == seen) continue;   // poll
+ *           uint64_t gen; nodeflow_shm_out_read(&mirror, values, changed, &gen, &seen);
+ *           ...
+ *       }
+ *   }
+ *
+ * examples/shm_reader.c is a complete reader.
+ */
+#ifndef NODEFLOW_SHM_H
+#define NODEFLOW_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NODEFLOW_SHM_IN_MAGIC 0x4E46494Eu /* "NFIN" */
+#define NODEFLOW_SHM_IN_VERSION 1u
+
+/* Dtypes (match NodeFlow::DType). Ingress records are converted to the
+ * node's value; string ports appear in the output mirror's descs only. */
+enum { NODEFLOW_SHM_INT = 0, NODEFLOW_SHM_FLOAT = 1, NODEFLOW_SHM_DOUBLE = 2, NODEFLOW_SHM_STRING = 3 };
+
+typedef struct nodeflow_shm_record {
+    int32_t handle;        /* port handle of the node to set */
+    uint32_t dtype;        /* NODEFLOW_SHM_*: which member of `value` is set */
+    union { int32_t i; float f; double d; } value;
+    uint64_t timestamp_ns; /* CLOCK_MONOTONIC at the sample, 0 = at drain */
+} nodeflow_shm_record;
+
+typedef struct nodeflow_shm_cell {
+    uint64_t seq;
+    nodeflow_shm_record rec;
+} nodeflow_shm_cell;
+
+typedef struct nodeflow_shm_in_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;     /* cells, power of two */
+    uint32_t record_size;  /* sizeof(nodeflow_shm_record) */
+    uint8_t pad0[48];
+    uint64_t head;         /* next slot to claim (producers) */
+    uint8_t pad1[56];
+    uint64_t tail;         /* next slot to read (runtime) */
+    uint8_t pad2[56];
+    uint64_t dropped;      /* pushes rejected because the ring was full */
+    uint32_t sleeping;     /* runtime is waiting on `wake` */
+    uint32_t wake;         /* futex word bumped by producers while it sleeps */
+    uint8_t pad3[48];
+} nodeflow_shm_in_header;
+
+typedef struct nodeflow_shm_in {
+    nodeflow_shm_in_header* hdr;
+    nodeflow_shm_cell* cells;
+    size_t bytes;
+} nodeflow_shm_in;
+
+static inline size_t nodeflow_shm_in_bytes(uint32_t capacity) {
+    return sizeof(nodeflow_shm_in_header) + (size_t)capacity * sizeof(nodeflow_shm_cell);
+}
+
+static inline uint64_t nodeflow_shm_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Attach to a ring created by the runtime. Returns 0, or -1 if the segment is
+ * missing or not a compatible ring. */
+static inline int nodeflow_shm_in_open(nodeflow_shm_in* r, const char* name) {
+    struct stat st;
+    void* p;
+    int fd = shm_open(name, O_RDWR, 0);
+    r->hdr = NULL;
+    r->cells = NULL;
+    r->bytes = 0;
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(nodeflow_shm_in_header)) {
+        close(fd);
+        return -1;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    r->hdr = (nodeflow_shm_in_header*)p;
+    r->bytes = (size_t)st.st_size;
+    if (r->hdr->magic != NODEFLOW_SHM_IN_MAGIC || r->hdr->version != NODEFLOW_SHM_IN_VERSION
+        || r->hdr->record_size != sizeof(nodeflow_shm_record)
+        || nodeflow_shm_in_bytes(r->hdr->capacity) > r->bytes) {
+        munmap(p, r->bytes);
+        r->hdr = NULL;
+        r->bytes = 0;
+        return -1;
+    }
+    r->cells = (nodeflow_shm_cell*)((char*)p + sizeof(nodeflow_shm_in_header));
+    return 0;
+}
+
+static inline void nodeflow_shm_in_close(nodeflow_shm_in* r) {
+    if (r->hdr) munmap(r->hdr, r->bytes);
+    r->hdr = NULL;
+    r->cells = NULL;
+    r->bytes = 0;
+}
+
+/* Queue one record; returns 1, or 0 when the ring is full (counted as dropped) */
+static inline int nodeflow_shm_in_push(nodeflow_shm_in* r, const nodeflow_shm_record* rec) {
+    nodeflow_shm_in_header* h = r->hdr;
+    const uint64_t mask = (uint64_t)h->capacity - 1;
+    uint64_t pos = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+    nodeflow_shm_cell* c;
+    for (;;) {
+        int64_t dif;
+        c = &r->cells[pos & mask];
+        dif = (int64_t)(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&h->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (dif < 0) {
+            __atomic_fetch_add(&h->dropped, 1, __ATOMIC_RELAXED);
+            return 0;
+        } else {
+            pos = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+        }
+    }
+    c->rec = *rec;
+    __atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+    /* Pairs with the runtime's fence before it re-checks the ring: either it
+     * sees this record or we see it sleeping */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->sleeping, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(&h->wake, 1, __ATOMIC_RELAXED);
+#if defined(__linux__)
+        syscall(SYS_futex, &h->wake, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+    }
+    return 1;
+}
+
+static inline int nodeflow_shm_in_push_float(nodeflow_shm_in* r, int32_t handle, float v) {
+    nodeflow_shm_record rec;
+    rec.handle = handle;
+    rec.dtype = NODEFLOW_SHM_FLOAT;
+    rec.value.d = 0.0;
+    rec.value.f = v;
+    rec.timestamp_ns = nodeflow_shm_now_ns();
+    return nodeflow_shm_in_push(r, &rec);
+}
+
+static inline int nodeflow_shm_in_push_int(nodeflow_shm_in* r, int32_t handle, int32_t v) {
+    nodeflow_shm_record rec;
+    rec.handle = handle;
+    rec.dtype = NODEFLOW_SHM_INT;
+    rec.value.d = 0.0;
+    rec.value.i = v;
+    rec.timestamp_ns = nodeflow_shm_now_ns();
+    return nodeflow_shm_in_push(r, &rec);
+}
+
+static inline int nodeflow_shm_in_push_double(nodeflow_shm_in* r, int32_t handle, double v) {
+    nodeflow_shm_record rec;
+    rec.handle = handle;
+    rec.dtype = NODEFLOW_SHM_DOUBLE;
+    rec.value.d = v;
+    rec.timestamp_ns = nodeflow_shm_now_ns();
+    return nodeflow_shm_in_push(r, &rec);
+}
+
+/* ---- Egress: output mirror -------------------------------------------- */
+
+#define NODEFLOW_SHM_OUT_MAGIC 0x4E464F55u /* "NFOU" */
+#define NODEFLOW_SHM_OUT_VERSION 1u
+#define NODEFLOW_SHM_NAME_BYTES 56
+
+typedef union nodeflow_shm_value {
+    int32_t i;
+    float f;
+    double d;
+    uint64_t bits;
+} nodeflow_shm_value;
+
+typedef struct nodeflow_shm_out_desc {
+    uint8_t dtype;         /* NODEFLOW_SHM_*; 0xFF = no port has this handle */
+    uint8_t is_output;
+    uint8_t pad[6];
+    char name[NODEFLOW_SHM_NAME_BYTES]; /* "node:port", NUL-terminated */
+} nodeflow_shm_out_desc;
+
+typedef struct nodeflow_shm_out_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;        /* port handles 0..slots-1 */
+    uint32_t bitmap_words; /* (slots + 63) / 64 */
+    uint32_t desc_size;    /* sizeof(nodeflow_shm_out_desc) */
+    uint8_t pad0[44];
+    uint64_t seq;          /* seqlock: odd while the writer updates */
+    uint64_t generation;   /* publishes so far: +1 each, so a gap means missed bitmaps */
+    uint64_t eval_generation; /* writer's eval count (WS binary frames carry the same) */
+    uint64_t timestamp_ns; /* CLOCK_MONOTONIC when it was published */
+    uint8_t pad1[32];
+} nodeflow_shm_out_header;
+
+typedef struct nodeflow_shm_out {
+    nodeflow_shm_out_header* hdr;
+    nodeflow_shm_out_desc* descs;
+    uint64_t* values;      /* nodeflow_shm_value bits */
+    uint64_t* changed;
+    size_t bytes;
+} nodeflow_shm_out;
+
+static inline size_t nodeflow_shm_out_bytes(uint32_t slots) {
+    return sizeof(nodeflow_shm_out_header) + (size_t)slots * (sizeof(nodeflow_shm_out_desc) + sizeof(uint64_t))
+         + (size_t)((slots + 63) / 64) * sizeof(uint64_t);
+}
+
+static inline void nodeflow_shm_out_bind(nodeflow_shm_out* m, void* p, size_t bytes, uint32_t slots) {
+    m->hdr = (nodeflow_shm_out_header*)p;
+    m->descs = (nodeflow_shm_out_desc*)((char*)p + sizeof(nodeflow_shm_out_header));
+    m->values = (uint64_t*)(m->descs + slots);
+    m->changed = m->values + slots;
+    m->bytes = bytes;
+}
+
+/* Reader: map a mirror created by the runtime (read-only). Returns 0, or -1
+ * if the segment is missing or not a compatible mirror. */
+static inline int nodeflow_shm_out_open(nodeflow_shm_out* m, const char* name) {
+    struct stat st;
+    void* p;
+    const nodeflow_shm_out_header* h;
+    int fd = shm_open(name, O_RDONLY, 0);
+    m->hdr = NULL;
+    m->bytes = 0;
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(nodeflow_shm_out_header)) {
+        close(fd);
+        return -1;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    h = (const nodeflow_shm_out_header*)p;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != NODEFLOW_SHM_OUT_MAGIC || h->version != NODEFLOW_SHM_OUT_VERSION
+        || h->desc_size != sizeof(nodeflow_shm_out_desc) || nodeflow_shm_out_bytes(h->slots) > (size_t)st.st_size) {
+        munmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    nodeflow_shm_out_bind(m, p, (size_t)st.st_size, h->slots);
+    return 0;
+}
+
+static inline void nodeflow_shm_out_close(nodeflow_shm_out* m) {
+    if (m->hdr) munmap(m->hdr, m->bytes);
+    m->hdr = NULL;
+    m->bytes = 0;
+}
+
+/* Current seqlock word: poll it and read when it moves */
+static inline uint64_t nodeflow_shm_out_seq(const nodeflow_shm_out* m) {
+    return __atomic_load_n(&m->hdr->seq, __ATOMIC_ACQUIRE);
+}
+
+/* Busy-wait hint for the seqlock retry loop */
+static inline void nodeflow_shm_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* Copy one consistent generation. `values` holds `slots` entries, `changed`
+ * `bitmap_words` (either may be NULL); `seq_out` receives the seqlock word
+ * the copy belongs to. Retries while the writer is mid-update. */
+static inline void nodeflow_shm_out_read(const nodeflow_shm_out* m, uint64_t* values, uint64_t* changed,
+                                         uint64_t* generation, uint64_t* seq_out) {
+    const nodeflow_shm_out_header* h = m->hdr;
+    for (;;) {
+        uint32_t i;
+        uint64_t gen;
+        const uint64_t s1 = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) { nodeflow_shm_pause(); continue; }
+        gen = __atomic_load_n(&h->generation, __ATOMIC_RELAXED);
+        if (values) for (i = 0; i < h->slots; ++i) values[i] = __atomic_load_n(&m->values[i], __ATOMIC_RELAXED);
+        if (changed) for (i = 0; i < h->bitmap_words; ++i) changed[i] = __atomic_load_n(&m->changed[i], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) != s1) { nodeflow_shm_pause(); continue; }
+        if (generation) *generation = gen;
+        if (seq_out) *seq_out = s1;
+        return;
+    }
+}
+
+/* Writer (the runtime / AOT host): create the segment for `slots` handles,
+ * replacing a stale one. Every slot starts undescribed. Returns 0 or -1. */
+static inline int nodeflow_shm_out_create(nodeflow_shm_out* m, const char* name, uint32_t slots) {
+    const size_t bytes = nodeflow_shm_out_bytes(slots);
+    void* p;
+    uint32_t i;
+    int fd;
+    m->hdr = NULL;
+    m->bytes = 0;
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+    nodeflow_shm_out_bind(m, p, bytes, slots);
+    for (i = 0; i < slots; ++i) m->descs[i].dtype = 0xFF;
+    m->hdr->version = NODEFLOW_SHM_OUT_VERSION;
+    m->hdr->slots = slots;
+    m->hdr->bitmap_words = (slots + 63) / 64;
+    m->hdr->desc_size = sizeof(nodeflow_shm_out_desc);
+    /* Readers check the magic last */
+    __atomic_store_n(&m->hdr->magic, NODEFLOW_SHM_OUT_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Unmap and remove the segment; mapped readers keep their view */
+static inline void nodeflow_shm_out_destroy(nodeflow_shm_out* m, const char* name) {
+    nodeflow_shm_out_close(m);
+    shm_unlink(name);
+}
+
+/* Name and type a slot; call before the first publish */
+static inline void nodeflow_shm_out_describe(nodeflow_shm_out* m, uint32_t handle, uint32_t dtype, int is_output,
+                                             const char* node_id, const char* port_id) {
+    nodeflow_shm_out_desc* d;
+    size_t n = 0;
+    if (handle >= m->hdr->slots) return;
+    d = &m->descs[handle];
+    d->dtype = (uint8_t)dtype;
+    d->is_output = is_output ? 1 : 0;
+    while (*node_id && n + 1 < NODEFLOW_SHM_NAME_BYTES) d->name[n++] = *node_id++;
+    if (n + 1 < NODEFLOW_SHM_NAME_BYTES) d->name[n++] = ':';
+    while (*port_id && n + 1 < NODEFLOW_SHM_NAME_BYTES) d->name[n++] = *port_id++;
+    d->name[n] = '\0';
+}
+
+/* One publish: begin, put each changed port, end */
+static inline void nodeflow_shm_out_begin(nodeflow_shm_out* m) {
+    uint32_t i;
+    __atomic_store_n(&m->hdr->seq, m->hdr->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); /* odd seq before any data */
+    for (i = 0; i < m->hdr->bitmap_words; ++i) __atomic_store_n(&m->changed[i], 0, __ATOMIC_RELAXED);
+}
+
+static inline void nodeflow_shm_out_put(nodeflow_shm_out* m, uint32_t handle, nodeflow_shm_value v) {
+    if (handle >= m->hdr->slots) return;
+    __atomic_store_n(&m->values[handle], v.bits, __ATOMIC_RELAXED);
+    /* Single writer: a plain read-modify-write, no locked instruction */
+    __atomic_store_n(&m->changed[handle / 64], __atomic_load_n(&m->changed[handle / 64], __ATOMIC_RELAXED) | ((uint64_t)1 << (handle % 64)),
+                     __ATOMIC_RELAXED);
+}
+
+static inline void nodeflow_shm_out_put_int(nodeflow_shm_out* m, uint32_t handle, int32_t x) {
+    nodeflow_shm_value v;
+    v.bits = 0;
+    v.i = x;
+    nodeflow_shm_out_put(m, handle, v);
+}
+
+static inline void nodeflow_shm_out_put_float(nodeflow_shm_out* m, uint32_t handle, float x) {
+    nodeflow_shm_value v;
+    v.bits = 0;
+    v.f = x;
+    nodeflow_shm_out_put(m, handle, v);
+}
+
+static inline void nodeflow_shm_out_put_double(nodeflow_shm_out* m, uint32_t handle, double x) {
+    nodeflow_shm_value v;
+    v.d = x;
+    nodeflow_shm_out_put(m, handle, v);
+}
+
+static inline void nodeflow_shm_out_end(nodeflow_shm_out* m, uint64_t eval_generation) {
+    __atomic_store_n(&m->hdr->generation, m->hdr->generation + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->hdr->eval_generation, eval_generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->hdr->timestamp_ns, nodeflow_shm_now_ns(), __ATOMIC_RELAXED);
+    __atomic_store_n(&m->hdr->seq, m->hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NODEFLOW_SHM_H */
@@ -0,0 +1,93 @@
+// alloc_tests.cpp
+//
+// Zero-allocation check for the WS delta path: after a warm-up, recording the
+// changed ports into PendingDelta, writing one JSON and one binary delta and
+// marking them sent must not touch the heap. Replaces the global operator new
+// with a counting one, so it is built as its own target (the runtime keeps
+// the default allocator unless NODEFLOW_COUNT_ALLOCS is on).
+
+#include "../NodeFlowCore.hpp"
+#include "../NodeFlowDelta.hpp"
+#include "../NodeFlowWire.hpp"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static std::atomic<bool> gCountAllocs{false};
+static std::atomic<unsigned long long> gAllocs{0};
+
+void* operator new(std::size_t n) {
+    if (gCountAllocs.load(std::memory_order_relaxed)) gAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+int main() {
+    // One output per numeric dtype, all moving on every set
+    NodeFlow::FlowEngine engine;
+    engine.loadFromJson(nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "v", "type": "Value", "inputs": [],
+             "outputs": [{"id": "i", "type": "int"}, {"id": "f", "type": "float"}, {"id": "d", "type": "double"}],
+             "parameters": {"value": 0}},
+            {"id": "sum", "type": "Add",
+             "inputs": [{"id": "in1", "type": "double"}, {"id": "in2", "type": "float"}],
+             "outputs": [{"id": "o", "type": "double"}]}
+        ],
+        "connections": [
+            {"fromNode": "v", "fromPort": "d", "toNode": "sum", "toPort": "in1"},
+            {"fromNode": "v", "fromPort": "f", "toNode": "sum", "toPort": "in2"}
+        ]
+    })"));
+    engine.setPublishSnapshots(true);
+    engine.execute();
+    engine.publishSnapshot();
+    NodeFlow::PendingDelta pending;
+    pending.layout(engine.getSnapshot()->descs);
+    NodeFlow::Wire::FrameWriter frame;
+    std::string text;
+    NodeFlow::Generation since = engine.currentEvalGeneration();
+
+    constexpr int kWarmupEvals = 100;
+    constexpr int kCountedEvals = 1000;
+    unsigned long long deltas = 0, allocs = 0;
+    for (int rr = 0; rr < kWarmupEvals + kCountedEvals; ++rr) {
+        engine.setNodeValue("v", static_cast<float>(rr % 7) + 0.25f);
+        engine.execute();
+        const bool counted = rr >= kWarmupEvals;
+        const auto allocs0 = gAllocs.load();
+        gCountAllocs = counted;
+        engine.forEachPortChangedSince(since, [&](NodeFlow::PortHandle h) { pending.record(h, engine.readPort(h), 0.0); });
+        since = engine.currentEvalGeneration();
+        if (!pending.empty()) {
+            text.assign("{\"type\":\"delta\"");
+            frame.begin(NodeFlow::Wire::Kind::Delta, deltas, since);
+            for (auto h : pending.changed()) {
+                if (!pending.pending(h)) continue;
+                pending.appendJson(text, h);
+                pending.addBinary(frame, h);
+            }
+            text += "}\n";
+            frame.finish();
+            if (counted) ++deltas;
+            pending.markSent();
+        }
+        gCountAllocs = false;
+        if (counted) allocs += gAllocs.load() - allocs0;
+    }
+    std::printf("ws delta: deltas=%llu allocs=%llu\n", deltas, allocs);
+    if (deltas == 0) {
+        std::fprintf(stderr, "no deltas were produced\n");
+        return 1;
+    }
+    if (allocs != 0) {
+        std::fprintf(stderr, "WS delta path allocates in steady state\n");
+        return 1;
+    }
+    return 0;
+}
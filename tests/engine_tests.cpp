@@ -0,0 +1,291 @@
+// engine_tests.cpp
+//
+// Regression checks for FlowEngine behaviour that the runtime depends on.
+// Plain asserts, no framework: failed checks are counted and main() exits
+// non-zero if any failed (run via ctest).
+
+#include "../NodeFlowCore.hpp"
+#include "../NodeFlowBatch.hpp"
+#include "../NodeFlowShm.hpp"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <unistd.h>
+
+using NodeFlow::FlowEngine;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static double asDouble(const NodeFlow::Value& v) {
+    if (std::holds_alternative<int>(v)) return static_cast<double>(std::get<int>(v));
+    if (std::holds_alternative<float>(v)) return static_cast<double>(std::get<float>(v));
+    if (std::holds_alternative<double>(v)) return std::get<double>(v);
+    return 0.0;
+}
+
+// A set on a Timer must not replace its interval_ms
+static void testTimerSetKeepsInterval() {
+    FlowEngine engine;
+    engine.loadFromJson(nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "t", "type": "Timer", "inputs": [],
+             "outputs": [{"id": "out1", "type": "double"}],
+             "parameters": {"interval_ms": 100}}
+        ],
+        "connections": []
+    })"));
+    const int out = engine.getPortHandle("t", "out1", "output");
+    engine.execute();
+    engine.tick(50.0);
+    engine.setNodeValue("t", 0.0f);
+    engine.execute();
+    CHECK(engine.nextTimerDueMs() == 50.0);
+    engine.tick(30.0);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(out)) == 0.0);
+    engine.tick(20.0);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(out)) == 1.0);
+}
+
+// A queued set followed by a batched set must end at the batch's value
+static void testQueuedSetThenBatch() {
+    FlowEngine engine;
+    engine.loadFromJson(nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "v", "type": "Value", "inputs": [],
+             "outputs": [{"id": "out1", "type": "float"}],
+             "parameters": {"value": 0}}
+        ],
+        "connections": []
+    })"));
+    const int out = engine.getPortHandle("v", "out1", "output");
+    engine.execute();
+    CHECK(engine.postInput(out, 1.0f));
+    const NodeFlow::InputValue batch[] = {{out, 2.0f}};
+    CHECK(engine.setNodeValues(batch, 1) == 1);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(out)) == 2.0);
+}
+
+// Every port of batch instance `instance` matches the FlowEngine run
+static bool sameAsBatch(const FlowEngine& engine, const NodeFlow::BatchFlowEngine& batch, size_t instance) {
+    for (const auto &pd : engine.getPortDescs()) {
+        if (asDouble(engine.readPort(pd.handle)) != asDouble(batch.readPort(instance, pd.handle))) {
+            std::fprintf(stderr, "  %s:%s differs on instance %zu\n", pd.nodeId.c_str(), pd.portId.c_str(), instance);
+            return false;
+        }
+    }
+    return true;
+}
+
+// A change on a non-primary output must re-evaluate its consumers in the
+// batch engine too: each instance tracks a FlowEngine fed the same sets
+static void testBatchMatchesEngine() {
+    const auto flow = nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "v", "type": "Value", "inputs": [],
+             "outputs": [{"id": "i", "type": "int"}, {"id": "f", "type": "float"}],
+             "parameters": {"value": 0}},
+            {"id": "b", "type": "Add", "inputs": [{"id": "in1", "type": "float"}],
+             "outputs": [{"id": "o", "type": "float"}]},
+            {"id": "t", "type": "Timer", "inputs": [],
+             "outputs": [{"id": "out1", "type": "int"}],
+             "parameters": {"interval_ms": 10}},
+            {"id": "c", "type": "Counter", "inputs": [{"id": "in1", "type": "int"}],
+             "outputs": [{"id": "out1", "type": "int"}]},
+            {"id": "sum", "type": "Add",
+             "inputs": [{"id": "in1", "type": "double"}, {"id": "in2", "type": "double"}],
+             "outputs": [{"id": "o", "type": "double"}]}
+        ],
+        "connections": [
+            {"fromNode": "v", "fromPort": "f", "toNode": "b", "toPort": "in1"},
+            {"fromNode": "t", "fromPort": "out1", "toNode": "c", "toPort": "in1"},
+            {"fromNode": "c", "fromPort": "out1", "toNode": "sum", "toPort": "in1"},
+            {"fromNode": "b", "fromPort": "o", "toNode": "sum", "toPort": "in2"}
+        ]
+    })");
+    const float sets[2][4] = {{0.2f, 0.4f, 1.7f, 1.9f}, {3.0f, 3.25f, 3.25f, -0.5f}};
+    FlowEngine engines[2];
+    NodeFlow::BatchFlowEngine batch;
+    batch.loadFromJson(flow, 2);
+    for (auto &e : engines) { e.loadFromJson(flow); e.execute(); }
+    batch.execute();
+    for (size_t k = 0; k < 4; ++k) {
+        for (size_t i = 0; i < 2; ++i) {
+            engines[i].setNodeValue("v", sets[i][k]);
+            engines[i].tick(5.0);
+            engines[i].execute();
+            batch.setNodeValue(i, "v", sets[i][k]);
+        }
+        batch.tick(5.0);
+        batch.execute();
+        for (size_t i = 0; i < 2; ++i) CHECK(sameAsBatch(engines[i], batch, i));
+    }
+}
+
+// A sub-band move neither stamps the port nor schedules its consumers, and
+// the batch engine holds the same value per instance
+static void testDeadband() {
+    const auto flow = nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "v", "type": "Value", "inputs": [],
+             "outputs": [{"id": "out1", "type": "float", "deadband": 0.5}],
+             "parameters": {"value": 0}},
+            {"id": "b", "type": "Add", "inputs": [{"id": "in1", "type": "float"}],
+             "outputs": [{"id": "o", "type": "float"}]}
+        ],
+        "connections": [
+            {"fromNode": "v", "fromPort": "out1", "toNode": "b", "toPort": "in1"}
+        ]
+    })");
+    FlowEngine engine;
+    engine.loadFromJson(flow);
+    const int out = engine.getPortHandle("v", "out1", "output");
+    const int sum = engine.getPortHandle("b", "o", "output");
+    engine.execute();
+    engine.setNodeValue("v", 1.0f);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(sum)) == 1.0);
+    const auto gen = engine.currentEvalGeneration();
+    engine.setNodeValue("v", 1.3f);
+    CHECK(!engine.hasPendingWork());
+    engine.execute();
+    bool stamped = false;
+    engine.forEachPortChangedSince(gen, [&](NodeFlow::PortHandle h) { stamped |= (h == out || h == sum); });
+    CHECK(!stamped);
+    CHECK(asDouble(engine.readPort(out)) == 1.0);
+    CHECK(asDouble(engine.readPort(sum)) == 1.0);
+
+    NodeFlow::BatchFlowEngine batch;
+    batch.loadFromJson(flow, 2);
+    batch.execute();
+    batch.setNodeValue(0, "v", 1.0f);
+    batch.setNodeValue(1, "v", 1.0f);
+    batch.execute();
+    batch.setNodeValue(0, "v", 1.3f);
+    batch.setNodeValue(1, "v", 1.6f);
+    batch.execute();
+    CHECK(asDouble(batch.readPort(0, sum)) == 1.0);
+    CHECK(asDouble(batch.readPort(1, sum)) == 1.6f);
+}
+
+static NodeFlow::Connection wire(const char* from, const char* fromPort, const char* to, const char* toPort) {
+    return NodeFlow::Connection{from, fromPort, to, toPort};
+}
+
+// Set `node`, run one eval and return how many nodes it evaluated; in a valid
+// topological order every affected node runs once and sees final inputs
+static unsigned long long setAndCount(FlowEngine& engine, const char* node, float value) {
+    engine.getAndResetPerfStats();
+    engine.setNodeValue(node, value);
+    engine.execute();
+    return engine.getAndResetPerfStats().nodesEvaluated;
+}
+
+// Incremental order repair (connect / reorderForEdge): consumers declared
+// before their producers, a rejected cycle, and edits after a removal
+static void testIncrementalOrder() {
+    FlowEngine engine;
+    engine.loadFromJson(nlohmann::json::parse(R"({
+        "nodes": [
+            {"id": "c", "type": "Add",
+             "inputs": [{"id": "in1", "type": "float"}, {"id": "in2", "type": "float"}],
+             "outputs": [{"id": "o", "type": "float"}]},
+            {"id": "b", "type": "Add",
+             "inputs": [{"id": "in1", "type": "float"}, {"id": "in2", "type": "float"}],
+             "outputs": [{"id": "o", "type": "float"}]},
+            {"id": "a", "type": "Value", "inputs": [],
+             "outputs": [{"id": "out1", "type": "float"}],
+             "parameters": {"value": 0}}
+        ],
+        "connections": []
+    })"));
+    const int c = engine.getPortHandle("c", "o", "output");
+    engine.execute();
+
+    // Both edges run against the load order (c, b, a)
+    engine.connect(wire("a", "out1", "b", "in1"));
+    engine.connect(wire("b", "o", "c", "in1"));
+    engine.execute();
+    CHECK(setAndCount(engine, "a", 3.0f) == 2);
+    CHECK(asDouble(engine.readPort(c)) == 3.0);
+
+    // Closing c -> b throws and leaves wires, order and outputs as they were
+    bool threw = false;
+    try {
+        engine.connect(wire("c", "o", "b", "in2"));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(engine.toJson()["connections"].size() == 2);
+    CHECK(asDouble(engine.readPort(c)) == 3.0);
+    CHECK(!engine.hasPendingWork());
+    CHECK(setAndCount(engine, "a", 5.0f) == 2);
+    CHECK(asDouble(engine.readPort(c)) == 5.0);
+
+    // After a removal, new edges (one inverting again) still order correctly
+    engine.removeNode("b");
+    engine.connect(wire("a", "out1", "c", "in1"));
+    engine.addNode(nlohmann::json::parse(R"({"id": "x", "type": "Add",
+        "inputs": [{"id": "in1", "type": "float"}], "outputs": [{"id": "o", "type": "float"}]})"));
+    engine.connect(wire("x", "o", "c", "in2"));
+    engine.connect(wire("a", "out1", "x", "in1"));
+    engine.execute();
+    CHECK(setAndCount(engine, "a", 2.0f) == 2);
+    CHECK(asDouble(engine.readPort(c)) == 4.0);
+}
+
+// --shm-in records queued against the old graph are dropped by a reload
+// instead of landing on whichever port now has their handle
+static void testReloadDropsShmRecords() {
+    const std::string name = "/nodeflow-test-" + std::to_string(static_cast<long>(getpid()));
+    NodeFlow::ShmInputRing ring(name, 16);
+    nodeflow_shm_in producer;
+    CHECK(nodeflow_shm_in_open(&producer, name.c_str()) == 0);
+    FlowEngine engine;
+    engine.setInputRing(&ring);
+    auto graph = [](const char* id) {
+        return nlohmann::json{
+            {"nodes", {{{"id", id}, {"type", "Value"}, {"inputs", nlohmann::json::array()},
+                        {"outputs", {{{"id", "out1"}, {"type", "float"}}}},
+                        {"parameters", {{"value", 1.0}}}}}},
+            {"connections", nlohmann::json::array()}};
+    };
+    engine.loadFromJson(graph("a"));
+    engine.execute();
+    const int h = engine.getPortHandle("a", "out1", "output");
+    CHECK(nodeflow_shm_in_push_float(&producer, h, 9.0f) == 1);
+    engine.loadFromJson(graph("z"));
+    CHECK(engine.getPortHandle("z", "out1", "output") == h);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(h)) == 1.0);
+    // Records pushed after the reload still apply
+    CHECK(nodeflow_shm_in_push_float(&producer, h, 4.0f) == 1);
+    engine.execute();
+    CHECK(asDouble(engine.readPort(h)) == 4.0);
+    nodeflow_shm_in_close(&producer);
+    engine.setInputRing(nullptr);
+}
+
+int main() {
+    testTimerSetKeepsInterval();
+    testQueuedSetThenBatch();
+    testBatchMatchesEngine();
+    testDeadband();
+    testIncrementalOrder();
+    testReloadDropsShmRecords();
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}